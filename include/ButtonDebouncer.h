@@ -0,0 +1,29 @@
+#ifndef BUTTONDEBOUNCER_H
+#define BUTTONDEBOUNCER_H
+
+#include <stdint.h>
+
+// Debounces up to eight buttons at once with a 2-bit vertical counter:
+// a bit only changes state after four consecutive matching samples.
+// Also generates auto-repeat events while a repeatable button is held.
+class ButtonDebouncer {
+private:
+  uint8_t state;        // Debounced, 1 = pressed
+  uint8_t count0;       // Vertical counter, low bit per button
+  uint8_t count1;       // Vertical counter, high bit per button
+  uint8_t repeatMask;   // Buttons that auto-repeat while held
+  unsigned long holdDelay;
+  unsigned long repeatInterval;
+  unsigned long nextRepeat;
+  uint8_t repeats;
+
+public:
+  ButtonDebouncer(uint8_t repeatMask, unsigned long holdDelay, unsigned long repeatInterval);
+
+  // raw: one bit per button, 1 = pressed. Returns press and repeat events.
+  uint8_t sample(uint8_t raw, unsigned long now);
+  uint8_t pressed() const;
+  uint8_t repeatCount() const;
+};
+
+#endif // BUTTONDEBOUNCER_H
@@ -1,15 +1,37 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// Relay Backend Selection (see RelayHal.h)
+#define RELAY_BACKEND_PCF8575 1     // PCF8575 I2C expander
+#define RELAY_BACKEND_AVR_PORT 2    // Relays wired directly to Mega port pins
+#define RELAY_BACKEND_MEMORY 3      // No hardware, for host tests
+#define RELAY_BACKEND_MEMORY_DEFERRED 4  // As MEMORY, but doses are cut off by the loop as on the PCF8575
+#ifndef RELAY_BACKEND
+#define RELAY_BACKEND RELAY_BACKEND_PCF8575
+#endif
+
 // Relay Expander (PCF8575) Configuration
 #define PCF8575_ADDRESS 0x25
-// Relays are wired to PCF8575 pins P0-P5 (active LOW)
-#define RELAY_STARCH_FEEDER P3
-#define RELAY_PAPER_SHREDDER P0
-#define RELAY_WATER_PUMP P5
-#define RELAY_MIXER P4
-#define RELAY_MIXER_DOOR P1
-#define RELAY_SPARE P2
+// Relay output bits (active LOW): PCF8575 pin Pn, or bit n of
+// RELAY_GPIO_PORT for the direct backend (PORTA bit n = Mega pin 22+n)
+#define RELAY_STARCH_FEEDER 3
+#define RELAY_PAPER_SHREDDER 0
+#define RELAY_WATER_PUMP 5
+#define RELAY_MIXER 4
+#define RELAY_MIXER_DOOR 1
+#define RELAY_SPARE 2
+
+// Direct GPIO Relay Port
+#define RELAY_GPIO_PORT PORTA
+#define RELAY_GPIO_DDR DDRA
+
+// Relay Rated Power in watts (defaults; adjustable over Serial)
+#define RATED_WATTS_STARCH 250
+#define RATED_WATTS_PAPER 750
+#define RATED_WATTS_WATER 370
+#define RATED_WATTS_MIXER 1500
+#define RATED_WATTS_DOOR 60
+#define RATED_WATTS_SPARE 0
 
 // Button Pin Definitions
 #define BTN_UP 5
@@ -21,11 +43,48 @@
 #define LCD_COLS 20
 #define LCD_ROWS 4
 
+// I2C Bus (shared by the LCD and the PCF8575)
+#define I2C_CLOCK 100000            // Bus clock in Hz
+#define I2C_TIMEOUT_US 25000        // A stuck transfer is abandoned and the bus reset after this
+
 // EEPROM Configuration
 #define EEPROM_MAGIC_NUMBER 0xAB  // Magic number to verify EEPROM data is valid
 #define EEPROM_MAGIC_ADDRESS 0
 #define EEPROM_DATA_ADDRESS 1
 
+#define EEPROM_SIZE 4096                // ATmega2560
+
+// Auto-run checkpoint ring buffer (power-fail resume). Every phase change
+// is recorded; only the dose phases are also recorded periodically, so a
+// resumed dose repeats at most DOSE_CHECKPOINT_INTERVAL of feed (the last
+// DOSE_ARM_WINDOW is covered by a record written just before arming). Slots
+// are 13 bytes on AVR, giving 226 slots. Each record costs its slot one
+// write per lap of the ring, and a cell is rated for 100,000 writes, so
+// the ring lasts about 22.6M records. A mould writes
+// 3 (4 with a remix) and a batch about 100 with the default doses. Back to
+// back 8 s mould cycles would wear it out in about 2 years of non-stop
+// running; two shifts a day at a mould every 30 s take about 8 years.
+#define CHECKPOINT_MAGIC 0xC6           // Marks a written checkpoint slot; bump when AutoState changes
+#define CHECKPOINT_BASE_ADDRESS 1152    // Start of the ring, after the energy block
+#define CHECKPOINT_SLOTS ((int)((EEPROM_SIZE - CHECKPOINT_BASE_ADDRESS) / sizeof(AutoCheckpoint)))
+#define DOSE_CHECKPOINT_INTERVAL 250    // Checkpoint period during dose phases in ms
+
+// Screen restored at boot (magic, MenuState)
+#define SCREEN_MAGIC 0x5C
+#define SCREEN_ADDRESS 32               // Between the timer block and the energy block
+
+// Energy totals. Rated watts sit in a fixed block; the lifetime and shift
+// on-time and shift length change on every save, so they go round a ring
+// of EnergyRecord slots (55 bytes on AVR, 17 slots). Saves come every
+// ENERGY_SAVE_INTERVAL while relays run, 96 a day, plus one per batch
+// stop, so with 20 batches a day a slot takes about 7 writes a day. At
+// 100,000 writes per cell that is around 40 years of round-the-clock running.
+#define ENERGY_MAGIC 0xE4               // Bump when the block layout changes
+#define ENERGY_ADDRESS 1024             // Magic and rated watts, up to the checkpoint ring
+#define ENERGY_RING_ADDRESS 64          // Counter ring, from after the screen block up to ENERGY_ADDRESS
+#define ENERGY_SLOTS ((int)((ENERGY_ADDRESS - ENERGY_RING_ADDRESS) / sizeof(EnergyRecord)))
+#define ENERGY_SAVE_INTERVAL 900000UL   // Persist at most every 15 min while relays run
+
 // Default Timer Values (in milliseconds)
 #define DEFAULT_STARCH_TIME 5000    // 5 seconds
 #define DEFAULT_PAPER_TIME 10000    // 10 seconds
@@ -34,10 +93,45 @@
 #define DEFAULT_DOOR_TIME 5000      // 5 seconds
 
 // Timing Constants
-#define DEBOUNCE_DELAY 50           // Button debounce delay in ms
+#define BUTTON_HOLD_DELAY 500       // Hold time before Up/Down auto-repeat in ms
+#define BUTTON_REPEAT_INTERVAL 150  // Auto-repeat period in ms
+#define EDIT_STEP_FAST_AFTER 10     // Repeats before timer edits step by 10 s
+#define EDIT_STEP_FASTEST_AFTER 25  // Repeats before timer edits step by 60 s
 #define MIXER_PREP_TIME 2000        // Mixer prep time in ms
 #define DOOR_CLOSE_TIME 2000        // Door closing time in ms
 
+// Mixer agitation while waiting at the moulding prompt
+#define AGITATE_GRACE_TIME 30000    // Mixer stays on this long after the prompt appears
+#define AGITATE_PERIOD 60000        // Then it cycles with this period...
+#define AGITATE_ON_TIME 10000       // ...running this long at the end of each period
+#define CATCH_UP_MIX_TIME 5000      // Mixer on-time needed before the door opens
+
+// Dose cut-off on Timer1 compare (16 us ticks, so at most ~1 s ahead)
+#define DOSE_ARM_WINDOW 250         // Arm the hardware deadline this many ms before a dose ends; keep <= DOSE_CHECKPOINT_INTERVAL
+#define DOSE_BACKSTOP 20            // ms past a deadline before the loop cuts a dose off itself
+
+#define SPLASH_TIMEOUT 1500         // Longest the boot splash stays up; any button dismisses it
+#define STOP_NOTICE_TIMEOUT 1500    // How long the emergency stop message stays up; buttons are ignored meanwhile
+
+// Mixer Current Sensing (adaptive mixing end-point)
+#define MIXER_CT_PIN A0             // Current transformer burden input
+#define CT_DECIMATION 192           // ADC samples per RMS block (~one 50 Hz cycle)
+#define PLATEAU_WINDOW 50           // RMS blocks per level comparison (~1 second)
+#define PLATEAU_TOLERANCE 20        // Max level change between windows (parts per 1000)
+#define PLATEAU_STABLE_WINDOWS 5    // Consecutive flat windows that end mixing
+#define PLATEAU_MIN_LEVEL 20        // RMS counts below which the mixer reads as unloaded
+#define MIN_MIXING_TIME 10000       // Mixing never ends on a plateau before this (ms)
+
+// Task Scheduler Periods (ms); each task's deadline equals its period
+#define INPUT_TASK_PERIOD 10
+#define SEQUENCE_TASK_PERIOD 10
+#define DISPLAY_TASK_PERIOD 50
+#define COMMS_TASK_PERIOD 20
+#define DISPLAY_REFRESH_INTERVAL 1000 // Countdown refresh during timed phases
+
+// Serial Configuration
+#define SERIAL_BAUD 115200
+
 // Timer Limits
 #define MIN_TIMER_VALUE 1000        // Minimum 1 second
 #define MAX_TIMER_VALUE 300000      // Maximum 5 minutes
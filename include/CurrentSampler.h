@@ -0,0 +1,40 @@
+#ifndef CURRENTSAMPLER_H
+#define CURRENTSAMPLER_H
+
+#include <Arduino.h>
+
+#define CURRENT_SAMPLER_QUEUE 8     // RMS blocks buffered between loop passes
+
+// Free-running ADC sampler for a current-transformer input.
+// The ADC interrupt accumulates raw samples and publishes one RMS block
+// per CT_DECIMATION conversions, so the main loop only ever drains a
+// short queue and never waits on a conversion.
+class CurrentSampler {
+private:
+  static CurrentSampler *instance;
+
+  // Owned by the ADC interrupt
+  uint16_t blockCount;
+  uint32_t blockSum;
+  uint32_t blockSumSquares;
+
+  // Block queue shared with the main loop
+  volatile uint32_t queue[CURRENT_SAMPLER_QUEUE];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  volatile uint16_t overruns;
+
+public:
+  CurrentSampler();
+  void begin(uint8_t pin);
+  bool available() const;
+  uint16_t read();
+  void flush();
+  uint16_t overrunCount() const;
+
+  // Called from the ADC conversion-complete interrupt
+  void handleSample(uint16_t sample);
+  static void handleInterrupt(uint16_t sample);
+};
+
+#endif // CURRENTSAMPLER_H
@@ -0,0 +1,54 @@
+#ifndef DOSETIMER_H
+#define DOSETIMER_H
+
+#include <Arduino.h>
+
+#define DOSE_TIMER_TICK_US (256000000UL / F_CPU)  // Timer1 tick at prescaler 256 (16 us)
+
+// One-shot dose deadline on the Timer1 compare A interrupt.
+// Timer1 free-runs at F_CPU/256, so a deadline can be armed up to ~1 s
+// ahead. When it matches, the interrupt runs the cut-off action (if any)
+// and flags the expiry. complete() then records how late the cut-off
+// landed against the armed deadline.
+class DoseTimer {
+private:
+  static DoseTimer *instance;
+
+  // Owned by the compare interrupt once armed
+  void (*action)(void *context);
+  void *context;
+  uint16_t deadline;
+  volatile uint16_t cutTick;
+  volatile bool armed;
+  volatile bool expired;
+
+  // Cut-off lateness against the deadline, in timer ticks
+  unsigned long count;
+  uint16_t minLate;
+  uint16_t maxLate;
+  uint32_t totalLate;
+  unsigned long missed;
+
+public:
+  DoseTimer();
+  void begin();
+  void arm(unsigned long delayUs, void (*cutOff)(void *context), void *cutOffContext);
+  void disarm();
+  bool isArmed() const;
+  bool fired() const;
+  void complete();
+  void recordMissed();
+
+  unsigned long cutoffCount() const;
+  unsigned long missedCount() const;
+  unsigned long minLateUs() const;
+  unsigned long maxLateUs() const;
+  unsigned long meanLateUs() const;
+  void resetStats();
+
+  // Called from the Timer1 compare A interrupt
+  void handleCompare();
+  static void handleInterrupt();
+};
+
+#endif // DOSETIMER_H
@@ -0,0 +1,36 @@
+#ifndef DURATIONSTATS_H
+#define DURATIONSTATS_H
+
+#include <stdint.h>
+
+// Count, min, max and mean of a series of durations in ms
+struct DurationStats {
+  unsigned long count;
+  unsigned long minMs;
+  unsigned long maxMs;
+  uint64_t totalMs;   // 64-bit so weeks of prompt waits cannot wrap the mean
+
+  DurationStats() { reset(); }
+
+  void reset()
+  {
+    count = 0;
+    minMs = 0;
+    maxMs = 0;
+    totalMs = 0;
+  }
+
+  void record(unsigned long ms)
+  {
+    if (count == 0 || ms < minMs)
+      minMs = ms;
+    if (ms > maxMs)
+      maxMs = ms;
+    totalMs += ms;
+    count++;
+  }
+
+  unsigned long meanMs() const { return count > 0 ? (unsigned long)(totalMs / count) : 0; }
+};
+
+#endif // DURATIONSTATS_H
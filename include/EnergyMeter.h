@@ -0,0 +1,44 @@
+#ifndef ENERGYMETER_H
+#define ENERGYMETER_H
+
+#include <Arduino.h>
+#include "RelayHal.h"
+
+enum EnergyScope {
+  ENERGY_MOULD,
+  ENERGY_BATCH,
+  ENERGY_SHIFT,
+  ENERGY_TOTAL,
+  ENERGY_SCOPES
+};
+
+// Integrates relay on-time per channel and turns it into an energy
+// estimate from each relay's rated power. update() must be called with
+// the new output mask every time the relays change.
+class EnergyMeter {
+private:
+  uint16_t ratedWatts[RELAY_CH_COUNT];
+  // Whole seconds plus a ms carry, so week-long scopes cannot wrap
+  unsigned long onSeconds[ENERGY_SCOPES][RELAY_CH_COUNT];
+  unsigned int onRemainder[ENERGY_SCOPES][RELAY_CH_COUNT];
+  unsigned long scopeStart[ENERGY_SCOPES];
+  uint8_t activeMask;
+  unsigned long lastUpdate;
+
+public:
+  EnergyMeter();
+  void update(unsigned long now, uint8_t mask);
+  void resetScope(EnergyScope scope, unsigned long now);
+
+  unsigned long onTimeSeconds(EnergyScope scope, uint8_t channel) const;
+  void setOnTimeSeconds(EnergyScope scope, uint8_t channel, unsigned long seconds);
+  unsigned long spanSeconds(EnergyScope scope, unsigned long now) const;
+  void setSpanSeconds(EnergyScope scope, unsigned long seconds, unsigned long now);
+  uint8_t dutyPercent(EnergyScope scope, uint8_t channel, unsigned long now) const;
+  float energyWh(EnergyScope scope) const;
+
+  uint16_t watts(uint8_t channel) const;
+  void setWatts(uint8_t channel, uint16_t watts);
+};
+
+#endif // ENERGYMETER_H
@@ -0,0 +1,45 @@
+#ifndef I2CPROFILER_H
+#define I2CPROFILER_H
+
+#include <Arduino.h>
+
+// Devices sharing the I2C bus
+enum I2cDevice {
+  I2C_DEV_LCD,
+  I2C_DEV_RELAYS,
+  I2C_DEV_COUNT
+};
+
+// Wire.endTransmission() results
+#define I2C_STATUS_OK 0
+#define I2C_STATUS_NACK_ADDRESS 2
+#define I2C_STATUS_NACK_DATA 3
+#define I2C_STATUS_TIMEOUT 5
+
+struct I2cDeviceStats {
+  unsigned long transactions;
+  unsigned long bytes;        // On the wire, address byte included
+  uint64_t busyMicros;        // Time the loop spent in this device's bus calls
+  unsigned long maxMicros;    // Longest single call
+  unsigned long nacks;
+  unsigned long timeouts;
+  unsigned long errors;       // Any other non-zero status
+};
+
+// Counting layer for Wire traffic; every bus call records into i2cProfiler
+class I2cProfiler {
+private:
+  I2cDeviceStats devices[I2C_DEV_COUNT];
+  unsigned long startTime;
+
+public:
+  I2cProfiler();
+  void record(uint8_t device, uint8_t transactions, uint16_t bytes, unsigned long micros, uint8_t status);
+  const I2cDeviceStats &device(uint8_t device) const;
+  unsigned long since() const;
+  void reset(unsigned long now);
+};
+
+extern I2cProfiler i2cProfiler;
+
+#endif // I2CPROFILER_H
@@ -3,9 +3,17 @@
 
 #include <Arduino.h>
 #include <Wire.h>
-#include <LiquidCrystal_I2C.h>
-#include <PCF8575.h>
 #include "Config.h"
+#include "RelayHal.h"
+#include "CurrentSampler.h"
+#include "PlateauDetector.h"
+#include "TaskScheduler.h"
+#include "EnergyMeter.h"
+#include "DurationStats.h"
+#include "ButtonDebouncer.h"
+#include "DoseTimer.h"
+#include "I2cProfiler.h"
+#include "ProfiledLcd.h"
 
 // Timer Structure
 struct Timers {
@@ -16,11 +24,54 @@ struct Timers {
   unsigned long doorOpenTime;
 };
 
+// Auto-run checkpoint record, one per EEPROM ring slot
+struct AutoCheckpoint {
+  byte magic;
+  unsigned int sequence;
+  byte autoState;
+  unsigned long elapsed;
+  unsigned int batchCount;
+  unsigned int mouldCount;
+  byte checksum;
+};
+
+// Energy on-time counters, one per EEPROM ring slot; rated watts are
+// stored apart since they only change on a WATTS command
+struct EnergyRecord {
+  unsigned int sequence;
+  unsigned long totalSeconds[RELAY_CH_COUNT];
+  unsigned long shiftSeconds[RELAY_CH_COUNT];
+  unsigned long shiftSpan;
+  byte checksum;
+};
+
+// Controller parameterized on the relay backend (see RelayHal.h)
+template <typename Relays>
 class MouldBotController {
 private:
-  LiquidCrystal_I2C lcd;
-  PCF8575 relayExpander;
+#ifdef MOULDBOT_HOST_TEST
+  friend struct ControllerProbe;  // Host tests read state that has no API
+#endif
+  typedef TaskScheduler<MouldBotController, 4> Scheduler;
+
+  ProfiledLcd lcd;
+  Relays relays;
   Timers timers;
+  CurrentSampler mixerCurrent;
+  PlateauDetector mixPlateau;
+  Scheduler scheduler;
+  EnergyMeter energy;
+  ButtonDebouncer buttons;
+  DoseTimer doseTimer;
+  
+  // Bit positions in the button scan
+  enum Button {
+    BUTTON_UP,
+    BUTTON_ENTER,
+    BUTTON_DOWN,
+    BUTTON_COUNT
+  };
+  static const uint8_t BUTTONS_ALL = _BV(BUTTON_UP) | _BV(BUTTON_ENTER) | _BV(BUTTON_DOWN);
   
   // Menu state enums
   enum MenuState {
@@ -28,13 +79,16 @@ private:
     SETTINGS_MENU,
     RUN_AUTO,
     TEST_MACHINE,
-    EDIT_TIMER
+    EDIT_TIMER,
+    RESUME_PROMPT,
+    ENERGY_VIEW
   };
   
   enum MainMenuOption {
     SETTINGS,
     RUN_AUTO_OPTION,
     TEST_MACHINE_OPTION,
+    ENERGY_OPTION,
     MAIN_MENU_COUNT
   };
   
@@ -58,6 +112,12 @@ private:
     TEST_COUNT
   };
   
+  enum ResumeOption {
+    RESUME_BATCH,
+    DISCARD_BATCH,
+    RESUME_COUNT
+  };
+  
   enum AutoState {
     AUTO_IDLE,
     AUTO_MIXER_PREP,
@@ -66,6 +126,7 @@ private:
     AUTO_WATER_PUMP,
     AUTO_MIXING,
     AUTO_MOULDING_PROMPT,
+    AUTO_CATCH_UP_MIX,
     AUTO_DOOR_OPEN,
     AUTO_DOOR_CLOSE,
     AUTO_COMPLETE
@@ -77,36 +138,99 @@ private:
   int editingTimer;
   unsigned long timerEditValue;
   
-  // Button state
-  bool lastUpState;
-  bool lastEnterState;
-  bool lastDownState;
-  unsigned long lastUpDebounceTime;
-  unsigned long lastEnterDebounceTime;
-  unsigned long lastDownDebounceTime;
+  // Button input registers, resolved from the pin numbers in begin()
+  volatile uint8_t *buttonPort[BUTTON_COUNT];
+  uint8_t buttonMask[BUTTON_COUNT];
   
   // Auto run state
   AutoState autoState;
   unsigned long stateStartTime;
+  unsigned long stateStartMicros;  // Dose deadlines are timed to the microsecond
   bool autoRunning;
+  uint8_t doseChannel;             // Relay the armed dose deadline cuts off
+  volatile unsigned long doseCutMillis;  // When the compare interrupt cut it off
+  unsigned long mixerOnSince;      // When the mixer relay last switched on
   
-  // Relay states for test mode
-  bool relayStates[5];
+  // Batch counters and power-fail checkpoint state
+  unsigned int batchCount;
+  unsigned int mouldCount;
+  unsigned int checkpointSequence;
+  int checkpointSlot;
+  AutoState checkpointState;
+  unsigned long lastCheckpointTime;
+  unsigned long resumeElapsed;
+  
+  // Boot state
+  bool splashActive;
+  unsigned long splashStart;
+  unsigned long relaysOffMicros;  // Reset to all relays released
+  unsigned long bootMicros;       // Reset to scheduler running
+  uint8_t savedScreen;
+  
+  // Emergency stop message, timed out by the display task
+  bool stopNoticeActive;
+  unsigned long stopNoticeStart;
+  
+  // Display and serial command state
+  bool displayDirty;
+  unsigned long lastDisplayTime;
+  char commandBuffer[32];
+  uint8_t commandLength;
+  char queryReply[192];        // Drained by commsTask() as TX space frees up
+  uint8_t replyLength;
+  uint8_t replySent;
+  bool ctStreaming;            // CT ON: mixer RMS blocks are echoed for capture
+  
+  // Energy accounting state
+  float lastMouldEnergy;
+  unsigned long lastEnergySave;
+  unsigned int energySequence;
+  int energySlot;
+  
+  // Throughput statistics
+  DurationStats phaseStats[AUTO_COMPLETE + 1];
+  DurationStats mouldStats;
+  uint64_t batchRunTime;       // Sum of completed phase times this batch
+  unsigned long lastMouldTime;
+  
+  // Scheduled tasks
+  void inputTask();
+  void sequenceTask();
+  void displayTask();
+  void commsTask();
+  
+  // Serial command methods
+  void handleCommand(const char *command);
+  void queueQueryReply();
+  void printTaskStats();
+  void printEnergyStats();
+  void printCycleStats();
+  void printDoseStats();
+  void printI2cStats();
   
   // Private methods
   void allRelaysOff();
-  void setRelay(int pin, bool state);
+  void restartMixPlateau();
+  void setRelay(uint8_t channel, bool state);
+  uint8_t readButtons();
   void handleButtons();
+  unsigned long editStep();
   void onUpPressed();
   void onDownPressed();
   void onEnterPressed();
   
   // Display methods
+  void requestDisplay();
+  void displaySplash();
+  void displayStopNotice();
   void displayMainMenu();
   void displaySettingsMenu();
   void displayTestMenu();
   void displayTimerEdit();
   void displayAutoStatus();
+  void displayResumePrompt();
+  void displayEnergy();
+  const char *phaseName(AutoState state);
   
   // Settings methods
   void enterTimerEdit(int timerIndex);
@@ -118,11 +242,32 @@ private:
   // Auto run methods
   void startAutoRun();
   void handleAutoSequence();
+  void enterAutoState(AutoState state);
+  void agitateMixer(unsigned long elapsed);
+  void openDoor();
+  bool doseComplete(uint8_t channel, unsigned long duration);
+  void finishDose();
+  static void cutOffDose(void *context);
+  void stopAutoRun();
+  void resumeAutoRun();
+  void restoreAutoOutputs();
+  
+  // Checkpoint methods
+  bool loadCheckpoint();
+  void saveCheckpoint();
+  void clearCheckpoint();
+  byte recordChecksum(const void *record, size_t length);
+  bool isTimedPhase(AutoState state);
+  bool isDosePhase(AutoState state);
   
   // EEPROM methods
   void loadTimersFromEEPROM();
   void saveTimersToEEPROM();
   void setDefaultTimers();
+  void loadLastScreen();
+  void saveLastScreen();
+  void loadEnergyFromEEPROM();
+  void saveEnergyToEEPROM();
 
 public:
   MouldBotController();
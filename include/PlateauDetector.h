@@ -0,0 +1,35 @@
+#ifndef PLATEAUDETECTOR_H
+#define PLATEAUDETECTOR_H
+
+#include <stdint.h>
+
+// Detects when a sampled load curve has flattened out.
+// Pure logic with no Arduino dependencies so it can be run on the host
+// against recorded mixer current traces.
+class PlateauDetector {
+private:
+  uint16_t windowLength;
+  uint16_t tolerance;
+  uint8_t stableWindows;
+  uint16_t minLevel;
+
+  uint32_t filtered;        // EMA of the input, scaled by 2^FILTER_SHIFT
+  bool primed;
+  uint16_t windowSamples;
+  uint16_t reference;       // Filtered level at the end of the previous window
+  uint8_t stableCount;
+
+public:
+  // windowLength: samples between level comparisons
+  // tolerance: max change between windows in parts per thousand
+  // stableWindows: consecutive flat windows that count as a plateau
+  // minLevel: filtered level below which the load is treated as absent
+  PlateauDetector(uint16_t windowLength, uint16_t tolerance, uint8_t stableWindows, uint16_t minLevel);
+
+  void reset();
+  bool addSample(uint16_t sample);
+  bool plateaued() const;
+  uint16_t level() const;
+};
+
+#endif // PLATEAUDETECTOR_H
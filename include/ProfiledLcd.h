@@ -0,0 +1,72 @@
+#ifndef PROFILEDLCD_H
+#define PROFILEDLCD_H
+
+#include <Wire.h>
+#include <LiquidCrystal_I2C.h>
+#include "I2cProfiler.h"
+
+// LiquidCrystal_I2C with its bus traffic recorded in i2cProfiler.
+// The library drops endTransmission() results and keeps its expander
+// writes private, so calls are timed as a whole and the transactions are
+// counted from how the library drives the HD44780 in 4-bit mode: each
+// byte is two nibbles of three single-byte writes (data, enable high,
+// enable low). Timeouts are seen through the Wire timeout flag; NACKs
+// are not visible here.
+class ProfiledLcd : public LiquidCrystal_I2C {
+private:
+  static const uint8_t BYTE_TRANSACTIONS = 6;
+  static const uint8_t INIT_TRANSACTIONS = 43;  // Backlight reset, 4 wake-up nibbles, 5 commands
+
+  void finish(unsigned long start, uint8_t transactions)
+  {
+    uint8_t status = I2C_STATUS_OK;
+    if (Wire.getWireTimeoutFlag())
+    {
+      Wire.clearWireTimeoutFlag();
+      status = I2C_STATUS_TIMEOUT;
+    }
+    i2cProfiler.record(I2C_DEV_LCD, transactions, transactions * 2, micros() - start, status);
+  }
+
+public:
+  ProfiledLcd(uint8_t address, uint8_t cols, uint8_t rows) : LiquidCrystal_I2C(address, cols, rows) {}
+
+  void init()
+  {
+    unsigned long start = micros();
+    LiquidCrystal_I2C::init();
+    finish(start, INIT_TRANSACTIONS);
+  }
+
+  void backlight()
+  {
+    unsigned long start = micros();
+    LiquidCrystal_I2C::backlight();
+    finish(start, 1);
+  }
+
+  void clear()
+  {
+    unsigned long start = micros();
+    LiquidCrystal_I2C::clear();
+    finish(start, BYTE_TRANSACTIONS);
+  }
+
+  void setCursor(uint8_t col, uint8_t row)
+  {
+    unsigned long start = micros();
+    LiquidCrystal_I2C::setCursor(col, row);
+    finish(start, BYTE_TRANSACTIONS);
+  }
+
+  // Every print() lands here one character at a time
+  virtual size_t write(uint8_t value)
+  {
+    unsigned long start = micros();
+    size_t written = LiquidCrystal_I2C::write(value);
+    finish(start, BYTE_TRANSACTIONS);
+    return written;
+  }
+};
+
+#endif // PROFILEDLCD_H
@@ -0,0 +1,205 @@
+#ifndef RELAYHAL_H
+#define RELAYHAL_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "Config.h"
+#include "I2cProfiler.h"
+
+// Logical relay channels, in the same order as the test menu entries
+enum RelayChannel {
+  RELAY_CH_STARCH,
+  RELAY_CH_PAPER,
+  RELAY_CH_WATER,
+  RELAY_CH_MIXER,
+  RELAY_CH_DOOR,
+  RELAY_CH_SPARE,
+  RELAY_CH_COUNT
+};
+
+// Output bit (expander pin or port bit) for each logical channel
+inline uint8_t relayOutputBit(uint8_t channel)
+{
+  switch (channel)
+  {
+  case RELAY_CH_STARCH:
+    return RELAY_STARCH_FEEDER;
+  case RELAY_CH_PAPER:
+    return RELAY_PAPER_SHREDDER;
+  case RELAY_CH_WATER:
+    return RELAY_WATER_PUMP;
+  case RELAY_CH_MIXER:
+    return RELAY_MIXER;
+  case RELAY_CH_DOOR:
+    return RELAY_MIXER_DOOR;
+  default:
+    return RELAY_SPARE;
+  }
+}
+
+// Compile-time relay HAL. Backends derive from RelayHal<Backend> and
+// provide beginOutputs(), writeChannel() and writeOutputs(); calls are
+// resolved statically so there is no virtual dispatch on a relay switch.
+// ISR_SAFE marks backends whose set() may be called from an interrupt.
+template <typename Backend>
+class RelayHal {
+protected:
+  volatile uint8_t energized;  // One bit per RelayChannel, set = relay on
+
+public:
+  RelayHal() : energized(0) {}
+
+  void begin()
+  {
+    backend().beginOutputs();
+    setAll(0);
+  }
+
+  void set(uint8_t channel, bool on)
+  {
+    if (on)
+      energized |= _BV(channel);
+    else
+      energized &= ~_BV(channel);
+    backend().writeChannel(channel, on);
+  }
+
+  // Switch every channel in a single write
+  void setAll(uint8_t mask)
+  {
+    energized = mask;
+    backend().writeOutputs(mask);
+  }
+
+  bool get(uint8_t channel) const { return energized & _BV(channel); }
+  uint8_t state() const { return energized; }
+
+private:
+  Backend &backend() { return static_cast<Backend &>(*this); }
+};
+
+// PCF8575 I2C expander, relays active LOW. The whole 16-bit port is
+// written in one transaction from a shadow of the energized mask.
+class Pcf8575Relays : public RelayHal<Pcf8575Relays> {
+public:
+  static const bool ISR_SAFE = false;  // Wire needs interrupts enabled
+
+  void beginOutputs() {}
+
+  void writeChannel(uint8_t /* channel */, bool /* on */)
+  {
+    writeOutputs(energized);
+  }
+
+  void writeOutputs(uint8_t mask)
+  {
+    // Unused pins stay HIGH (quasi-bidirectional input / relay off)
+    uint16_t port = 0xFFFF;
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+      if (mask & _BV(channel))
+        port &= ~(1U << relayOutputBit(channel));
+    }
+
+    unsigned long start = micros();
+    Wire.beginTransmission(PCF8575_ADDRESS);
+    Wire.write(port & 0xFF);
+    Wire.write(port >> 8);
+    uint8_t status = Wire.endTransmission();
+    if (Wire.getWireTimeoutFlag())
+    {
+      Wire.clearWireTimeoutFlag();
+      status = I2C_STATUS_TIMEOUT;
+    }
+    i2cProfiler.record(I2C_DEV_RELAYS, 1, 3, micros() - start, status);
+  }
+};
+
+// Relays wired straight to one AVR port (RELAY_GPIO_PORT), active LOW.
+// writeChannel() touches only that channel's port bit: a single sbi/cbi
+// when the channel is a compile-time constant, otherwise a read-modify-
+// write of the port. set() also read-modify-writes the volatile energized
+// mask, so it is not atomic against an interrupt that switches relays too.
+class AvrPortRelays : public RelayHal<AvrPortRelays> {
+public:
+  static const bool ISR_SAFE = true;
+
+  void beginOutputs()
+  {
+    uint8_t bits = portBits(0xFF);
+    RELAY_GPIO_PORT |= bits;  // Drive HIGH before enabling outputs
+    RELAY_GPIO_DDR |= bits;
+  }
+
+  void writeChannel(uint8_t channel, bool on)
+  {
+    if (on)
+      RELAY_GPIO_PORT &= ~_BV(relayOutputBit(channel));
+    else
+      RELAY_GPIO_PORT |= _BV(relayOutputBit(channel));
+  }
+
+  void writeOutputs(uint8_t mask)
+  {
+    uint8_t relayBits = portBits(0xFF);
+    RELAY_GPIO_PORT = (RELAY_GPIO_PORT & ~relayBits) | (relayBits & ~portBits(mask));
+  }
+
+private:
+  static uint8_t portBits(uint8_t mask)
+  {
+    uint8_t bits = 0;
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+      if (mask & _BV(channel))
+        bits |= _BV(relayOutputBit(channel));
+    }
+    return bits;
+  }
+};
+
+// In-memory outputs for host-side tests; records what the hardware would see.
+// IsrSafe false makes the controller cut doses off from the loop, as it
+// does on the PCF8575.
+template <bool IsrSafe>
+class BasicMemoryRelays : public RelayHal<BasicMemoryRelays<IsrSafe> > {
+private:
+  uint8_t outputs;
+  unsigned long writes;
+
+public:
+  static const bool ISR_SAFE = IsrSafe;
+
+  BasicMemoryRelays() : outputs(0), writes(0) {}
+
+  void beginOutputs() {}
+
+  void writeChannel(uint8_t /* channel */, bool /* on */)
+  {
+    writeOutputs(this->energized);
+  }
+
+  void writeOutputs(uint8_t mask)
+  {
+    outputs = mask;
+    writes++;
+  }
+
+  uint8_t outputState() const { return outputs; }
+  unsigned long writeCount() const { return writes; }
+};
+
+typedef BasicMemoryRelays<true> MemoryRelays;
+typedef BasicMemoryRelays<false> DeferredMemoryRelays;
+
+#if RELAY_BACKEND == RELAY_BACKEND_AVR_PORT
+typedef AvrPortRelays RelayBackend;
+#elif RELAY_BACKEND == RELAY_BACKEND_MEMORY
+typedef MemoryRelays RelayBackend;
+#elif RELAY_BACKEND == RELAY_BACKEND_MEMORY_DEFERRED
+typedef DeferredMemoryRelays RelayBackend;
+#else
+typedef Pcf8575Relays RelayBackend;
+#endif
+
+#endif // RELAYHAL_H
@@ -0,0 +1,110 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <Arduino.h>
+
+// Cooperative fixed-capacity scheduler for member-function tasks.
+// Each pass runs every released task in priority order and records its
+// CPU time and whether it finished within its deadline.
+template <typename Owner, uint8_t Capacity>
+class TaskScheduler {
+public:
+  typedef void (Owner::*TaskFunction)();
+
+  struct Task {
+    const char *name;
+    TaskFunction function;
+    unsigned long period;       // ms between releases, 0 = every pass
+    unsigned long deadline;     // ms from release to completion
+    uint8_t priority;           // Lower value runs first
+    unsigned long nextRelease;
+    unsigned long runs;
+    unsigned long totalMicros;
+    unsigned long maxMicros;
+    unsigned long misses;
+  };
+
+private:
+  Owner &owner;
+  Task tasks[Capacity];
+  uint8_t count;
+
+public:
+  TaskScheduler(Owner &owner) : owner(owner), count(0) {}
+
+  bool add(const char *name, TaskFunction function, unsigned long period, unsigned long deadline, uint8_t priority)
+  {
+    if (count >= Capacity)
+      return false;
+
+    // Keep the table sorted by priority so run() is a single ordered sweep
+    uint8_t index = count;
+    while (index > 0 && tasks[index - 1].priority > priority)
+    {
+      tasks[index] = tasks[index - 1];
+      index--;
+    }
+
+    Task &task = tasks[index];
+    task.name = name;
+    task.function = function;
+    task.period = period;
+    task.deadline = deadline;
+    task.priority = priority;
+    task.nextRelease = 0;
+    count++;
+    resetStats();
+    return true;
+  }
+
+  void start(unsigned long now)
+  {
+    for (uint8_t i = 0; i < count; i++)
+      tasks[i].nextRelease = now;
+  }
+
+  void run()
+  {
+    for (uint8_t i = 0; i < count; i++)
+    {
+      Task &task = tasks[i];
+      unsigned long now = millis();
+
+      if ((long)(now - task.nextRelease) < 0)
+        continue;
+
+      unsigned long release = task.nextRelease;
+      unsigned long startMicros = micros();
+      (owner.*task.function)();
+      unsigned long used = micros() - startMicros;
+
+      task.runs++;
+      task.totalMicros += used;
+      if (used > task.maxMicros)
+        task.maxMicros = used;
+      if (task.period > 0 && millis() - release > task.deadline)
+        task.misses++;
+
+      // Stay on the period grid, but skip releases missed while overrun
+      task.nextRelease = release + task.period;
+      if ((long)(millis() - task.nextRelease) >= 0)
+        task.nextRelease = millis() + task.period;
+    }
+  }
+
+  void resetStats()
+  {
+    for (uint8_t i = 0; i < count; i++)
+    {
+      tasks[i].runs = 0;
+      tasks[i].totalMicros = 0;
+      tasks[i].maxMicros = 0;
+      tasks[i].misses = 0;
+    }
+  }
+
+  uint8_t taskCount() const { return count; }
+  const Task &task(uint8_t index) const { return tasks[index]; }
+};
+
+#endif // TASKSCHEDULER_H
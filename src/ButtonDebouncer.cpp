@@ -0,0 +1,49 @@
+#include "ButtonDebouncer.h"
+
+ButtonDebouncer::ButtonDebouncer(uint8_t repeatMask, unsigned long holdDelay, unsigned long repeatInterval)
+    : repeatMask(repeatMask), holdDelay(holdDelay), repeatInterval(repeatInterval)
+{
+    state = 0;
+    count0 = 0;
+    count1 = 0;
+    nextRepeat = 0;
+    repeats = 0;
+}
+
+uint8_t ButtonDebouncer::sample(uint8_t raw, unsigned long now)
+{
+    // Count samples that disagree with the debounced state; any agreeing
+    // sample clears that button's counter
+    uint8_t delta = raw ^ state;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+
+    // Bits whose counter wrapped after four disagreeing samples flip
+    uint8_t toggle = delta & ~(count0 | count1);
+    state ^= toggle;
+
+    uint8_t events = toggle & state;
+    if (toggle)
+    {
+        nextRepeat = now + holdDelay;
+        repeats = 0;
+    }
+    else if ((state & repeatMask) && (long)(now - nextRepeat) >= 0)
+    {
+        events |= state & repeatMask;
+        nextRepeat += repeatInterval;
+        if (repeats < 255)
+            repeats++;
+    }
+    return events;
+}
+
+uint8_t ButtonDebouncer::pressed() const
+{
+    return state;
+}
+
+uint8_t ButtonDebouncer::repeatCount() const
+{
+    return repeats;
+}
@@ -0,0 +1,118 @@
+#include "CurrentSampler.h"
+#include "Config.h"
+#include <util/atomic.h>
+
+CurrentSampler *CurrentSampler::instance = 0;
+
+CurrentSampler::CurrentSampler()
+{
+    blockCount = 0;
+    blockSum = 0;
+    blockSumSquares = 0;
+    head = 0;
+    tail = 0;
+    overruns = 0;
+}
+
+void CurrentSampler::begin(uint8_t pin)
+{
+    uint8_t channel = pin >= A0 ? pin - A0 : pin;
+    instance = this;
+
+    // AVcc reference, right adjusted, channel 0-15 split across ADMUX/ADCSRB
+    ADMUX = _BV(REFS0) | (channel & 0x07);
+    ADCSRB = (channel & 0x08) ? _BV(MUX5) : 0; // ADTS = 0: free-running trigger
+
+    // Prescaler 128: 125 kHz ADC clock, ~9.6k conversions per second
+    ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+bool CurrentSampler::available() const
+{
+    return head != tail;
+}
+
+uint16_t CurrentSampler::read()
+{
+    uint32_t meanSquare;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (head == tail)
+            return 0;
+        meanSquare = queue[tail];
+        tail = (tail + 1) % CURRENT_SAMPLER_QUEUE;
+    }
+
+    // Integer square root turns the AC power term into RMS counts
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > meanSquare)
+        bit >>= 2;
+    while (bit != 0)
+    {
+        if (meanSquare >= root + bit)
+        {
+            meanSquare -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void CurrentSampler::flush()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tail = head;
+    }
+}
+
+uint16_t CurrentSampler::overrunCount() const
+{
+    return overruns;
+}
+
+void CurrentSampler::handleSample(uint16_t sample)
+{
+    blockSum += sample;
+    blockSumSquares += (uint32_t)sample * sample;
+
+    if (++blockCount < CT_DECIMATION)
+        return;
+
+    // Variance about the block mean strips the CT mid-rail bias
+    uint32_t mean = blockSum / CT_DECIMATION;
+    uint32_t meanSquare = blockSumSquares / CT_DECIMATION - mean * mean;
+
+    uint8_t next = (head + 1) % CURRENT_SAMPLER_QUEUE;
+    if (next != tail)
+    {
+        queue[head] = meanSquare;
+        head = next;
+    }
+    else
+    {
+        overruns++;
+    }
+
+    blockCount = 0;
+    blockSum = 0;
+    blockSumSquares = 0;
+}
+
+void CurrentSampler::handleInterrupt(uint16_t sample)
+{
+    if (instance)
+        instance->handleSample(sample);
+}
+
+ISR(ADC_vect)
+{
+    CurrentSampler::handleInterrupt(ADC);
+}
@@ -0,0 +1,151 @@
+#include "DoseTimer.h"
+#include <util/atomic.h>
+
+DoseTimer *DoseTimer::instance = 0;
+
+DoseTimer::DoseTimer()
+{
+    action = 0;
+    context = 0;
+    deadline = 0;
+    cutTick = 0;
+    armed = false;
+    expired = false;
+    resetStats();
+}
+
+void DoseTimer::begin()
+{
+    instance = this;
+
+    // Normal mode, prescaler 256; takes Timer1 from the core's PWM setup
+    // (analogWrite on pins 11 and 12 is not used by this machine)
+    TIMSK1 = 0;
+    TCCR1A = 0;
+    TCCR1B = _BV(CS12);
+}
+
+void DoseTimer::arm(unsigned long delayUs, void (*cutOff)(void *context), void *cutOffContext)
+{
+    // A compare value only a tick ahead can be passed before it is written
+    unsigned long ticks = delayUs / DOSE_TIMER_TICK_US;
+    if (ticks < 2)
+        ticks = 2;
+    if (ticks > 0xFFFF)
+        ticks = 0xFFFF;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        action = cutOff;
+        context = cutOffContext;
+        deadline = TCNT1 + (uint16_t)ticks;
+        OCR1A = deadline;
+        expired = false;
+        armed = true;
+        TIFR1 = _BV(OCF1A);  // Drop a match left over from the last deadline
+        TIMSK1 |= _BV(OCIE1A);
+    }
+}
+
+void DoseTimer::disarm()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TIMSK1 &= ~_BV(OCIE1A);
+        armed = false;
+        expired = false;
+    }
+}
+
+bool DoseTimer::isArmed() const
+{
+    return armed;
+}
+
+bool DoseTimer::fired() const
+{
+    return expired;
+}
+
+void DoseTimer::complete()
+{
+    uint16_t late;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Without an interrupt action the caller has just done the cut-off
+        if (!action)
+            cutTick = TCNT1;
+        late = cutTick - deadline;
+        armed = false;
+        expired = false;
+    }
+
+    if (count == 0 || late < minLate)
+        minLate = late;
+    if (late > maxLate)
+        maxLate = late;
+    totalLate += late;
+    count++;
+}
+
+void DoseTimer::recordMissed()
+{
+    missed++;
+}
+
+unsigned long DoseTimer::cutoffCount() const
+{
+    return count;
+}
+
+unsigned long DoseTimer::missedCount() const
+{
+    return missed;
+}
+
+unsigned long DoseTimer::minLateUs() const
+{
+    return (unsigned long)minLate * DOSE_TIMER_TICK_US;
+}
+
+unsigned long DoseTimer::maxLateUs() const
+{
+    return (unsigned long)maxLate * DOSE_TIMER_TICK_US;
+}
+
+unsigned long DoseTimer::meanLateUs() const
+{
+    return count > 0 ? totalLate / count * DOSE_TIMER_TICK_US : 0;
+}
+
+void DoseTimer::resetStats()
+{
+    count = 0;
+    minLate = 0;
+    maxLate = 0;
+    totalLate = 0;
+    missed = 0;
+}
+
+void DoseTimer::handleCompare()
+{
+    TIMSK1 &= ~_BV(OCIE1A);
+    if (action)
+    {
+        action(context);
+        cutTick = TCNT1;
+    }
+    expired = true;
+}
+
+void DoseTimer::handleInterrupt()
+{
+    if (instance && instance->armed)
+        instance->handleCompare();
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+    DoseTimer::handleInterrupt();
+}
@@ -0,0 +1,106 @@
+#include "EnergyMeter.h"
+#include "Config.h"
+
+EnergyMeter::EnergyMeter()
+{
+    static const uint16_t defaultWatts[RELAY_CH_COUNT] = {
+        RATED_WATTS_STARCH, RATED_WATTS_PAPER, RATED_WATTS_WATER,
+        RATED_WATTS_MIXER, RATED_WATTS_DOOR, RATED_WATTS_SPARE};
+
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        ratedWatts[channel] = defaultWatts[channel];
+    }
+    for (uint8_t scope = 0; scope < ENERGY_SCOPES; scope++)
+    {
+        resetScope((EnergyScope)scope, 0);
+    }
+    activeMask = 0;
+    lastUpdate = 0;
+}
+
+void EnergyMeter::update(unsigned long now, uint8_t mask)
+{
+    // Credit the interval since the last change to the relays that were on
+    unsigned long interval = now - lastUpdate;
+
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT && interval > 0; channel++)
+    {
+        if (!(activeMask & _BV(channel)))
+            continue;
+
+        for (uint8_t scope = 0; scope < ENERGY_SCOPES; scope++)
+        {
+            unsigned long carry = onRemainder[scope][channel] + interval;
+            onSeconds[scope][channel] += carry / 1000;
+            onRemainder[scope][channel] = carry % 1000;
+        }
+    }
+
+    activeMask = mask;
+    lastUpdate = now;
+}
+
+void EnergyMeter::resetScope(EnergyScope scope, unsigned long now)
+{
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        onSeconds[scope][channel] = 0;
+        onRemainder[scope][channel] = 0;
+    }
+    scopeStart[scope] = now;
+}
+
+unsigned long EnergyMeter::onTimeSeconds(EnergyScope scope, uint8_t channel) const
+{
+    return onSeconds[scope][channel];
+}
+
+void EnergyMeter::setOnTimeSeconds(EnergyScope scope, uint8_t channel, unsigned long seconds)
+{
+    onSeconds[scope][channel] = seconds;
+    onRemainder[scope][channel] = 0;
+}
+
+unsigned long EnergyMeter::spanSeconds(EnergyScope scope, unsigned long now) const
+{
+    return (now - scopeStart[scope]) / 1000;
+}
+
+void EnergyMeter::setSpanSeconds(EnergyScope scope, unsigned long seconds, unsigned long now)
+{
+    // Backdate the start so a restored scope keeps its length
+    scopeStart[scope] = now - seconds * 1000;
+}
+
+uint8_t EnergyMeter::dutyPercent(EnergyScope scope, uint8_t channel, unsigned long now) const
+{
+    unsigned long span = now - scopeStart[scope];
+    if (span == 0)
+        return 0;
+
+    float onMs = (float)onSeconds[scope][channel] * 1000 + onRemainder[scope][channel];
+    unsigned long percent = (unsigned long)(onMs * 100 / span);
+    return percent > 100 ? 100 : percent;
+}
+
+float EnergyMeter::energyWh(EnergyScope scope) const
+{
+    float wattSeconds = 0;
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        float seconds = onSeconds[scope][channel] + onRemainder[scope][channel] / 1000.0;
+        wattSeconds += ratedWatts[channel] * seconds;
+    }
+    return wattSeconds / 3600.0;
+}
+
+uint16_t EnergyMeter::watts(uint8_t channel) const
+{
+    return ratedWatts[channel];
+}
+
+void EnergyMeter::setWatts(uint8_t channel, uint16_t watts)
+{
+    ratedWatts[channel] = watts;
+}
@@ -0,0 +1,60 @@
+#include "I2cProfiler.h"
+
+I2cProfiler i2cProfiler;
+
+I2cProfiler::I2cProfiler()
+{
+    reset(0);
+}
+
+void I2cProfiler::record(uint8_t device, uint8_t transactions, uint16_t bytes, unsigned long micros, uint8_t status)
+{
+    I2cDeviceStats &stats = devices[device];
+    stats.transactions += transactions;
+    stats.bytes += bytes;
+    stats.busyMicros += micros;
+    if (micros > stats.maxMicros)
+        stats.maxMicros = micros;
+
+    switch (status)
+    {
+    case I2C_STATUS_OK:
+        break;
+    case I2C_STATUS_NACK_ADDRESS:
+    case I2C_STATUS_NACK_DATA:
+        stats.nacks++;
+        break;
+    case I2C_STATUS_TIMEOUT:
+        stats.timeouts++;
+        break;
+    default:
+        stats.errors++;
+        break;
+    }
+}
+
+const I2cDeviceStats &I2cProfiler::device(uint8_t device) const
+{
+    return devices[device];
+}
+
+unsigned long I2cProfiler::since() const
+{
+    return startTime;
+}
+
+void I2cProfiler::reset(unsigned long now)
+{
+    for (uint8_t i = 0; i < I2C_DEV_COUNT; i++)
+    {
+        I2cDeviceStats &stats = devices[i];
+        stats.transactions = 0;
+        stats.bytes = 0;
+        stats.busyMicros = 0;
+        stats.maxMicros = 0;
+        stats.nacks = 0;
+        stats.timeouts = 0;
+        stats.errors = 0;
+    }
+    startTime = now;
+}
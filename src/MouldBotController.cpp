@@ -1,210 +1,743 @@
 #include "MouldBotController.h"
 #include <EEPROM.h>
+#include <inttypes.h>
+#include <stddef.h>
 
-MouldBotController::MouldBotController() : lcd(LCD_ADDRESS, LCD_COLS, LCD_ROWS), relayExpander(PCF8575_ADDRESS)
+// avr-libc heap bounds, used to report free RAM
+extern char __heap_start;
+extern char *__brkval;
+
+static int freeMemory()
+{
+    char top;
+    return &top - (__brkval ? __brkval : &__heap_start);
+}
+
+// Replaces a timer outside the editable range; true if it had to
+static bool repairTimer(unsigned long &value, unsigned long fallback)
+{
+    if (value >= MIN_TIMER_VALUE && value <= MAX_TIMER_VALUE)
+        return false;
+    value = fallback;
+    return true;
+}
+
+template <typename Relays>
+MouldBotController<Relays>::MouldBotController()
+    : lcd(LCD_ADDRESS, LCD_COLS, LCD_ROWS),
+      mixPlateau(PLATEAU_WINDOW, PLATEAU_TOLERANCE, PLATEAU_STABLE_WINDOWS, PLATEAU_MIN_LEVEL),
+      scheduler(*this),
+      buttons(_BV(BUTTON_UP) | _BV(BUTTON_DOWN), BUTTON_HOLD_DELAY, BUTTON_REPEAT_INTERVAL)
 {
     currentState = MAIN_MENU;
     currentMenuIndex = 0;
     editingTimer = -1;
 
-    lastUpState = HIGH;
-    lastEnterState = HIGH;
-    lastDownState = HIGH;
-  lastUpDebounceTime = 0;
-  lastEnterDebounceTime = 0;
-  lastDownDebounceTime = 0;
-
-    for (int i = 0; i < 5; i++)
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++)
     {
-        relayStates[i] = false;
+        buttonPort[i] = 0;
+        buttonMask[i] = 0;
     }
+
+    autoState = AUTO_IDLE;
+    autoRunning = false;
+
+    batchCount = 0;
+    mouldCount = 0;
+    checkpointSequence = 0;
+    checkpointSlot = CHECKPOINT_SLOTS - 1;
+    checkpointState = AUTO_IDLE;
+    lastCheckpointTime = 0;
+    resumeElapsed = 0;
+
+    splashActive = false;
+    splashStart = 0;
+    relaysOffMicros = 0;
+    bootMicros = 0;
+    savedScreen = MAIN_MENU;
+
+    stopNoticeActive = false;
+    stopNoticeStart = 0;
+
+    displayDirty = false;
+    lastDisplayTime = 0;
+    commandLength = 0;
+    replyLength = 0;
+    replySent = 0;
+    ctStreaming = false;
+
+    lastMouldEnergy = 0;
+    lastEnergySave = 0;
+    energySequence = 0;
+    energySlot = ENERGY_SLOTS - 1;
+
+    stateStartTime = 0;
+    stateStartMicros = 0;
+    doseChannel = RELAY_CH_COUNT;
+    doseCutMillis = 0;
+    mixerOnSince = 0;
+    batchRunTime = 0;
+    lastMouldTime = 0;
 }
 
-void MouldBotController::begin()
+template <typename Relays>
+void MouldBotController<Relays>::begin()
 {
-    // Ensure I2C is up before talking to LCD or PCF8575
+    // Ensure I2C is up before talking to LCD or PCF8575; the relays are
+    // released at the default 100 kHz
     Wire.begin();
+    Wire.setWireTimeout(I2C_TIMEOUT_US, true);
+
+    // Release every relay in one write before anything slower runs
+    relays.begin();
+    relaysOffMicros = micros();
+
+    Serial.begin(SERIAL_BAUD);
 
     // Initialize LCD
     lcd.init();
-    lcd.backlight();
 
-    // Initialize relay expander pins (active LOW relays)
-    relayExpander.begin();
-    relayExpander.pinMode(RELAY_STARCH_FEEDER, OUTPUT);
-    relayExpander.pinMode(RELAY_PAPER_SHREDDER, OUTPUT);
-    relayExpander.pinMode(RELAY_WATER_PUMP, OUTPUT);
-    relayExpander.pinMode(RELAY_MIXER, OUTPUT);
-    relayExpander.pinMode(RELAY_MIXER_DOOR, OUTPUT);
-    relayExpander.pinMode(RELAY_SPARE, OUTPUT);
+    // lcd.init() calls Wire.begin() again, which puts the bus back to
+    // 100 kHz, so the clock is only set once it has run. The timeout is
+    // reapplied with it in case the core resets that too
+    Wire.setClock(I2C_CLOCK);
+    Wire.setWireTimeout(I2C_TIMEOUT_US, true);
+    lcd.backlight();
+    displaySplash();
 
     pinMode(BTN_UP, INPUT_PULLUP);
     pinMode(BTN_ENTER, INPUT_PULLUP);
     pinMode(BTN_DOWN, INPUT_PULLUP);
 
-    // Turn off all relays
-    allRelaysOff();
+    // Resolve button pins to port registers once; scans then read the ports directly
+    const uint8_t buttonPins[BUTTON_COUNT] = {BTN_UP, BTN_ENTER, BTN_DOWN};
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++)
+    {
+        buttonPort[i] = portInputRegister(digitalPinToPort(buttonPins[i]));
+        buttonMask[i] = digitalPinToBitMask(buttonPins[i]);
+    }
 
-    // Show welcome message
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("   MouldBot v1.0   ");
-    lcd.setCursor(0, 1);
-    lcd.print("  Initializing...  ");
-    delay(1000);
+    // Mixer current is sampled continuously in the background
+    mixerCurrent.begin(MIXER_CT_PIN);
+    doseTimer.begin();
 
-    // Load timers from EEPROM
-    lcd.setCursor(0, 2);
-    lcd.print("Loading Settings... ");
     loadTimersFromEEPROM();
-    delay(1000);
+    loadEnergyFromEEPROM();
+    loadLastScreen();
 
-    displayMainMenu();
+    // Offer to pick up a batch that was interrupted by a power loss
+    if (loadCheckpoint())
+    {
+        currentState = RESUME_PROMPT;
+        currentMenuIndex = RESUME_BATCH;
+    }
+    requestDisplay();
+
+    // Input is polled first so button presses are never queued behind the LCD
+    scheduler.add("input", &MouldBotController::inputTask, INPUT_TASK_PERIOD, INPUT_TASK_PERIOD, 0);
+    scheduler.add("sequence", &MouldBotController::sequenceTask, SEQUENCE_TASK_PERIOD, SEQUENCE_TASK_PERIOD, 1);
+    scheduler.add("display", &MouldBotController::displayTask, DISPLAY_TASK_PERIOD, DISPLAY_TASK_PERIOD, 2);
+    scheduler.add("comms", &MouldBotController::commsTask, COMMS_TASK_PERIOD, COMMS_TASK_PERIOD, 3);
+    scheduler.start(millis());
+
+    // The splash stays up without holding the loop; inputs are live from here
+    splashActive = true;
+    splashStart = millis();
+    bootMicros = micros();
+    Serial.print(F("boot_us "));
+    Serial.println(bootMicros);
 }
 
-void MouldBotController::update()
+template <typename Relays>
+void MouldBotController<Relays>::update()
+{
+    // An expired dose is served every loop pass, ahead of the task round
+    if (doseTimer.fired())
+        finishDose();
+    scheduler.run();
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::inputTask()
 {
     handleButtons();
+}
 
+template <typename Relays>
+void MouldBotController<Relays>::sequenceTask()
+{
     if (currentState == RUN_AUTO && autoRunning)
     {
         handleAutoSequence();
     }
-}
 
-void MouldBotController::allRelaysOff()
-{
-    relayExpander.digitalWrite(RELAY_STARCH_FEEDER, HIGH);
-    delay(50);
-    relayExpander.digitalWrite(RELAY_PAPER_SHREDDER, HIGH);
-    delay(50);
-    relayExpander.digitalWrite(RELAY_WATER_PUMP, HIGH);
-    delay(50);
-    relayExpander.digitalWrite(RELAY_MIXER, HIGH);
-    delay(50);
-    relayExpander.digitalWrite(RELAY_MIXER_DOOR, HIGH);
-    delay(50);
-    relayExpander.digitalWrite(RELAY_SPARE, HIGH);
-    delay(50);
-}
+    // Bound how much on-time a power loss can drop without wearing EEPROM;
+    // an armed dose deadline is never kept waiting behind the write
+    if (relays.state() != 0 && !doseTimer.isArmed() && millis() - lastEnergySave >= ENERGY_SAVE_INTERVAL)
+    {
+        saveEnergyToEEPROM();
+    }
 
-void MouldBotController::setRelay(int pin, bool state)
-{
-    relayExpander.digitalWrite(pin, state ? LOW : HIGH);
-    delay(50);  // Delay after relay operation to stabilize power
+    saveLastScreen();
 }
 
-void MouldBotController::handleButtons()
+template <typename Relays>
+void MouldBotController<Relays>::displayTask()
 {
     unsigned long currentTime = millis();
-    
-    // Read current button states
-    bool upReading = digitalRead(BTN_UP) == LOW;
-    bool enterReading = digitalRead(BTN_ENTER) == LOW;
-    bool downReading = digitalRead(BTN_DOWN) == LOW;
 
-    // Emergency stop - all 3 buttons pressed during auto run
-    if (currentState == RUN_AUTO && autoRunning && upReading && enterReading && downReading)
+    // No I2C traffic while a dose deadline is armed; the countdown catches
+    // up once the dose has been cut off
+    if (doseTimer.isArmed())
+        return;
+
+    if (splashActive)
     {
-        autoRunning = false;
-        allRelaysOff();
-        currentState = MAIN_MENU;
-        currentMenuIndex = 0;
-        lcd.clear();
-        lcd.setCursor(0, 1);
-        lcd.print("AUTO RUN STOPPED!");
-        delay(1500);
-        displayMainMenu();
+        if (currentTime - splashStart < SPLASH_TIMEOUT)
+            return;
+        splashActive = false;
+        displayDirty = true;
+    }
+
+    if (stopNoticeActive)
+    {
+        if (currentTime - stopNoticeStart < STOP_NOTICE_TIMEOUT)
+        {
+            if (displayDirty)
+            {
+                displayDirty = false;
+                displayStopNotice();
+            }
+            return;
+        }
+        stopNoticeActive = false;
+        displayDirty = true;
+    }
+
+    // Timed auto phases count down and the energy page ticks once a second
+    if (((currentState == RUN_AUTO && isTimedPhase(autoState)) || currentState == ENERGY_VIEW) &&
+        currentTime - lastDisplayTime >= DISPLAY_REFRESH_INTERVAL)
+    {
+        displayDirty = true;
+    }
+
+    if (!displayDirty)
         return;
+    displayDirty = false;
+    lastDisplayTime = currentTime;
+
+    switch (currentState)
+    {
+    case MAIN_MENU:
+        displayMainMenu();
+        break;
+    case SETTINGS_MENU:
+        displaySettingsMenu();
+        break;
+    case RUN_AUTO:
+        displayAutoStatus();
+        break;
+    case TEST_MACHINE:
+        displayTestMenu();
+        break;
+    case EDIT_TIMER:
+        displayTimerEdit();
+        break;
+    case RESUME_PROMPT:
+        displayResumePrompt();
+        break;
+    case ENERGY_VIEW:
+        displayEnergy();
+        break;
     }
+}
 
-    // Handle UP button - detect press on falling edge with debounce
-    if (upReading && !lastUpState)
+template <typename Relays>
+void MouldBotController<Relays>::commsTask()
+{
+    // Push out as much of a pending query reply as the TX buffer takes now
+    if (replySent < replyLength)
     {
-        if ((currentTime - lastUpDebounceTime) > DEBOUNCE_DELAY)
+        int room = Serial.availableForWrite();
+        int pending = replyLength - replySent;
+        int count = room < pending ? room : pending;
+        if (count > 0)
         {
-            onUpPressed();
-            lastUpDebounceTime = currentTime;
+            Serial.write((const uint8_t *)queryReply + replySent, count);
+            replySent += count;
         }
     }
-    lastUpState = upReading;
 
-    // Handle ENTER button - detect press on falling edge with debounce
-    if (enterReading && !lastEnterState)
+    // Commands can print hundreds of bytes or save to EEPROM; with a dose
+    // armed they wait in the RX buffer until it has been cut off
+    if (doseTimer.isArmed())
+        return;
+
+    while (Serial.available() > 0)
     {
-        if ((currentTime - lastEnterDebounceTime) > DEBOUNCE_DELAY)
+        char c = Serial.read();
+
+        if (c == '\r' || c == '\n')
         {
-            onEnterPressed();
-            lastEnterDebounceTime = currentTime;
+            if (commandLength > 0)
+            {
+                commandBuffer[commandLength] = '\0';
+                handleCommand(commandBuffer);
+                commandLength = 0;
+            }
         }
+        else if (commandLength < sizeof(commandBuffer) - 1)
+        {
+            commandBuffer[commandLength++] = c;
+        }
+    }
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::handleCommand(const char *command)
+{
+    if (strcmp(command, "Q") == 0)
+    {
+        queueQueryReply();
+    }
+    else if (strcmp(command, "STATS") == 0)
+    {
+        printTaskStats();
+    }
+    else if (strcmp(command, "STATS RESET") == 0)
+    {
+        scheduler.resetStats();
+        Serial.println(F("OK"));
+    }
+    else if (strcmp(command, "CYCLES") == 0)
+    {
+        printCycleStats();
+    }
+    else if (strcmp(command, "CYCLES RESET") == 0)
+    {
+        for (uint8_t i = 0; i <= AUTO_COMPLETE; i++)
+            phaseStats[i].reset();
+        mouldStats.reset();
+        Serial.println(F("OK"));
+    }
+    else if (strcmp(command, "DOSE") == 0)
+    {
+        printDoseStats();
+    }
+    else if (strcmp(command, "DOSE RESET") == 0)
+    {
+        doseTimer.resetStats();
+        Serial.println(F("OK"));
+    }
+    else if (strcmp(command, "I2C") == 0)
+    {
+        printI2cStats();
+    }
+    else if (strcmp(command, "I2C RESET") == 0)
+    {
+        i2cProfiler.reset(millis());
+        Serial.println(F("OK"));
+    }
+    else if (strcmp(command, "ENERGY") == 0)
+    {
+        printEnergyStats();
+    }
+    else if (strcmp(command, "CT ON") == 0)
+    {
+        ctStreaming = true;
+        Serial.println(F("OK"));
+    }
+    else if (strcmp(command, "CT OFF") == 0)
+    {
+        ctStreaming = false;
+        Serial.println(F("OK"));
+    }
+    else if (strcmp(command, "SHIFT RESET") == 0)
+    {
+        energy.update(millis(), relays.state());
+        energy.resetScope(ENERGY_SHIFT, millis());
+        saveEnergyToEEPROM();
+        Serial.println(F("OK"));
+    }
+    else if (strncmp(command, "WATTS ", 6) == 0)
+    {
+        // WATTS <channel> <rated watts>
+        char *end;
+        unsigned long channel = strtoul(command + 6, &end, 10);
+        unsigned long watts = strtoul(end, &end, 10);
+
+        if (channel < RELAY_CH_COUNT && watts <= 65535 && *end == '\0')
+        {
+            energy.setWatts(channel, watts);
+            saveEnergyToEEPROM();
+            Serial.println(F("OK"));
+        }
+        else
+        {
+            Serial.println(F("ERR usage: WATTS <channel 0-5> <watts>"));
+        }
+    }
+    else
+    {
+        Serial.print(F("ERR unknown command: "));
+        Serial.println(command);
+    }
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::queueQueryReply()
+{
+    // A poller re-asking before the last reply drained just waits for that one
+    if (replySent < replyLength)
+        return;
+
+    // Q t=<ms> st=<menu> ph=<phase> el=<ms in phase> b=<batch> m=<moulds>
+    //   mc=<cycles> ma=<mean cycle ms> pt=<mean ms per phase, prep..door close>
+    int length = snprintf(queryReply, sizeof(queryReply),
+                          "Q t=%" PRIu32 " st=%u ph=%u el=%" PRIu32 " b=%u m=%u mc=%" PRIu32 " ma=%" PRIu32 " pt=",
+                          (uint32_t)millis(), (unsigned)currentState, (unsigned)autoState,
+                          (uint32_t)(autoRunning ? millis() - stateStartTime : 0UL), batchCount, mouldCount,
+                          (uint32_t)mouldStats.count, (uint32_t)mouldStats.meanMs());
+
+    for (uint8_t i = AUTO_MIXER_PREP; i < AUTO_COMPLETE && length < (int)sizeof(queryReply); i++)
+    {
+        length += snprintf(queryReply + length, sizeof(queryReply) - length, i == AUTO_MIXER_PREP ? "%" PRIu32 : ",%" PRIu32,
+                           (uint32_t)phaseStats[i].meanMs());
+    }
+    if (length < (int)sizeof(queryReply))
+        length += snprintf(queryReply + length, sizeof(queryReply) - length, "\r\n");
+
+    replyLength = length < (int)sizeof(queryReply) ? length : sizeof(queryReply) - 1;
+    replySent = 0;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::printTaskStats()
+{
+    Serial.println(F("task runs avg_us max_us misses"));
+    for (uint8_t i = 0; i < scheduler.taskCount(); i++)
+    {
+        const typename Scheduler::Task &task = scheduler.task(i);
+        Serial.print(task.name);
+        Serial.print(' ');
+        Serial.print(task.runs);
+        Serial.print(' ');
+        Serial.print(task.runs > 0 ? task.totalMicros / task.runs : 0);
+        Serial.print(' ');
+        Serial.print(task.maxMicros);
+        Serial.print(' ');
+        Serial.println(task.misses);
+    }
+
+    // Gap between heap and stack; should stay flat however long the unit runs
+    Serial.print(F("free_ram "));
+    Serial.println(freeMemory());
+
+    // Time from reset until the relays were released and until the loop ran
+    Serial.print(F("relays_off_us "));
+    Serial.println(relaysOffMicros);
+    Serial.print(F("boot_us "));
+    Serial.println(bootMicros);
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::printCycleStats()
+{
+    Serial.println(F("phase count min_ms avg_ms max_ms"));
+    for (uint8_t i = AUTO_MIXER_PREP; i < AUTO_COMPLETE; i++)
+    {
+        const DurationStats &stats = phaseStats[i];
+        Serial.print(phaseName((AutoState)i));
+        Serial.print(' ');
+        Serial.print(stats.count);
+        Serial.print(' ');
+        Serial.print(stats.minMs);
+        Serial.print(' ');
+        Serial.print(stats.meanMs());
+        Serial.print(' ');
+        Serial.println(stats.maxMs);
     }
-    lastEnterState = enterReading;
 
-    // Handle DOWN button - detect press on falling edge with debounce
-    if (downReading && !lastDownState)
+    Serial.print(F("mould_cycle "));
+    Serial.print(mouldStats.count);
+    Serial.print(' ');
+    Serial.print(mouldStats.minMs);
+    Serial.print(' ');
+    Serial.print(mouldStats.meanMs());
+    Serial.print(' ');
+    Serial.println(mouldStats.maxMs);
+
+    // Throughput over the running batch, including operator waits
+    float batchTime = (float)batchRunTime + (millis() - stateStartTime);
+    Serial.print(F("batch_moulds_per_hour "));
+    Serial.println(autoRunning && batchTime > 0 ? mouldCount * 3600000.0 / batchTime : 0, 1);
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::printDoseStats()
+{
+    // Lateness of each timer-driven cut-off against its deadline
+    Serial.println(F("cutoffs min_late_us avg_late_us max_late_us missed"));
+    Serial.print(doseTimer.cutoffCount());
+    Serial.print(' ');
+    Serial.print(doseTimer.minLateUs());
+    Serial.print(' ');
+    Serial.print(doseTimer.meanLateUs());
+    Serial.print(' ');
+    Serial.print(doseTimer.maxLateUs());
+    Serial.print(' ');
+    Serial.println(doseTimer.missedCount());
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::printI2cStats()
+{
+    static const char *const names[I2C_DEV_COUNT] = {"lcd", "relays"};
+    static const uint8_t addresses[I2C_DEV_COUNT] = {LCD_ADDRESS, PCF8575_ADDRESS};
+    float window = (millis() - i2cProfiler.since()) * 1000.0;
+
+    // busy is time the loop spent in each device's calls; wire is the
+    // estimated clocking time for its bytes (9 bits each) at I2C_CLOCK
+    Serial.println(F("dev addr tx bytes busy_ms busy% max_us wire_ms nacks timeouts errors"));
+    for (uint8_t i = 0; i < I2C_DEV_COUNT; i++)
     {
-        if ((currentTime - lastDownDebounceTime) > DEBOUNCE_DELAY)
+        const I2cDeviceStats &stats = i2cProfiler.device(i);
+        Serial.print(names[i]);
+        Serial.print(F(" 0x"));
+        Serial.print(addresses[i], HEX);
+        Serial.print(' ');
+        Serial.print(stats.transactions);
+        Serial.print(' ');
+        Serial.print(stats.bytes);
+        Serial.print(' ');
+        Serial.print((unsigned long)(stats.busyMicros / 1000));
+        Serial.print(' ');
+        Serial.print(window > 0 ? stats.busyMicros * 100.0 / window : 0, 2);
+        Serial.print(' ');
+        Serial.print(stats.maxMicros);
+        Serial.print(' ');
+        Serial.print(stats.bytes * 9000.0 / I2C_CLOCK, 1);
+        Serial.print(' ');
+        Serial.print(stats.nacks);
+        Serial.print(' ');
+        Serial.print(stats.timeouts);
+        Serial.print(' ');
+        Serial.println(stats.errors);
+    }
+
+    Serial.print(F("clock_hz "));
+    Serial.println((unsigned long)I2C_CLOCK);
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::printEnergyStats()
+{
+    static const char *const names[RELAY_CH_COUNT] = {"starch", "paper", "water", "mixer", "door", "spare"};
+    unsigned long now = millis();
+    energy.update(now, relays.state());
+
+    Serial.println(F("ch relay watts batch_s shift_s shift_duty% total_s"));
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        Serial.print(channel);
+        Serial.print(' ');
+        Serial.print(names[channel]);
+        Serial.print(' ');
+        Serial.print(energy.watts(channel));
+        Serial.print(' ');
+        Serial.print(energy.onTimeSeconds(ENERGY_BATCH, channel));
+        Serial.print(' ');
+        Serial.print(energy.onTimeSeconds(ENERGY_SHIFT, channel));
+        Serial.print(' ');
+        Serial.print(energy.dutyPercent(ENERGY_SHIFT, channel, now));
+        Serial.print(' ');
+        Serial.println(energy.onTimeSeconds(ENERGY_TOTAL, channel));
+    }
+
+    Serial.print(F("batch_wh "));
+    Serial.println(energy.energyWh(ENERGY_BATCH), 2);
+    Serial.print(F("batch_wh_per_mould "));
+    Serial.println(mouldCount > 0 ? energy.energyWh(ENERGY_BATCH) / mouldCount : 0, 2);
+    Serial.print(F("last_mould_wh "));
+    Serial.println(lastMouldEnergy, 2);
+    Serial.print(F("shift_wh "));
+    Serial.println(energy.energyWh(ENERGY_SHIFT), 2);
+    Serial.print(F("shift_span_s "));
+    Serial.println(energy.spanSeconds(ENERGY_SHIFT, now));
+    Serial.print(F("total_kwh "));
+    Serial.println(energy.energyWh(ENERGY_TOTAL) / 1000.0, 3);
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::requestDisplay()
+{
+    displayDirty = true;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::allRelaysOff()
+{
+    // Releasing loads draws no inrush, so one write with no settle delay
+    relays.setAll(0);
+    energy.update(millis(), relays.state());
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::setRelay(uint8_t channel, bool state)
+{
+    // Every output change passes through here, so on-time is integrated once
+    if (channel == RELAY_CH_MIXER && state && !relays.get(RELAY_CH_MIXER))
+    {
+        mixerOnSince = millis();
+    }
+    relays.set(channel, state);
+    energy.update(millis(), relays.state());
+    delay(50);  // Delay after relay operation to stabilize power
+}
+
+template <typename Relays>
+uint8_t MouldBotController<Relays>::readButtons()
+{
+    uint8_t raw = 0;
+    uint8_t snapshot[BUTTON_COUNT];
+
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++)
+    {
+        // Buttons sharing a port reuse one register read
+        uint8_t shared = i;
+        for (uint8_t j = 0; j < i && shared == i; j++)
         {
-            onDownPressed();
-            lastDownDebounceTime = currentTime;
+            if (buttonPort[j] == buttonPort[i])
+                shared = j;
         }
+        snapshot[i] = shared < i ? snapshot[shared] : *buttonPort[i];
+
+        // Inputs are pulled up, so a pressed button reads LOW
+        if (!(snapshot[i] & buttonMask[i]))
+            raw |= _BV(i);
     }
-    lastDownState = downReading;
+    return raw;
 }
 
-void MouldBotController::onUpPressed()
+template <typename Relays>
+void MouldBotController<Relays>::handleButtons()
+{
+    uint8_t events = buttons.sample(readButtons(), millis());
+
+    // The first press only dismisses the splash
+    if (splashActive && events)
+    {
+        splashActive = false;
+        requestDisplay();
+        return;
+    }
+
+    // Buttons still coming off an emergency stop must not drive the menu
+    if (stopNoticeActive)
+        return;
+
+    // Emergency stop - all 3 buttons pressed during auto run
+    if (currentState == RUN_AUTO && autoRunning && buttons.pressed() == BUTTONS_ALL)
+    {
+        stopAutoRun();
+        currentState = MAIN_MENU;
+        currentMenuIndex = 0;
+
+        // The display task shows the notice, then the main menu
+        stopNoticeActive = true;
+        stopNoticeStart = millis();
+        requestDisplay();
+        return;
+    }
+
+    if (events & _BV(BUTTON_UP))
+        onUpPressed();
+    if (events & _BV(BUTTON_ENTER))
+        onEnterPressed();
+    if (events & _BV(BUTTON_DOWN))
+        onDownPressed();
+}
+
+template <typename Relays>
+unsigned long MouldBotController<Relays>::editStep()
+{
+    // Holding Up/Down accelerates from 1 s to 10 s to 60 s steps
+    uint8_t repeats = buttons.repeatCount();
+    if (repeats >= EDIT_STEP_FASTEST_AFTER)
+        return 60000;
+    if (repeats >= EDIT_STEP_FAST_AFTER)
+        return 10000;
+    return 1000;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::onUpPressed()
 {
     if (currentState == MAIN_MENU)
     {
         currentMenuIndex = (currentMenuIndex - 1 + MAIN_MENU_COUNT) % MAIN_MENU_COUNT;
-        displayMainMenu();
+        requestDisplay();
     }
     else if (currentState == SETTINGS_MENU)
     {
         currentMenuIndex = (currentMenuIndex - 1 + SETTINGS_COUNT) % SETTINGS_COUNT;
-        displaySettingsMenu();
+        requestDisplay();
     }
     else if (currentState == TEST_MACHINE)
     {
         currentMenuIndex = (currentMenuIndex - 1 + TEST_COUNT) % TEST_COUNT;
-        displayTestMenu();
+        requestDisplay();
     }
     else if (currentState == EDIT_TIMER)
     {
-        timerEditValue += 1000; // Increase by 1 second
+        timerEditValue += editStep();
         if (timerEditValue > MAX_TIMER_VALUE)
             timerEditValue = MAX_TIMER_VALUE;
-        displayTimerEdit();
+        requestDisplay();
+    }
+    else if (currentState == RESUME_PROMPT)
+    {
+        currentMenuIndex = (currentMenuIndex - 1 + RESUME_COUNT) % RESUME_COUNT;
+        requestDisplay();
     }
 }
 
-void MouldBotController::onDownPressed()
+template <typename Relays>
+void MouldBotController<Relays>::onDownPressed()
 {
     if (currentState == MAIN_MENU)
     {
         currentMenuIndex = (currentMenuIndex + 1) % MAIN_MENU_COUNT;
-        displayMainMenu();
+        requestDisplay();
     }
     else if (currentState == SETTINGS_MENU)
     {
         currentMenuIndex = (currentMenuIndex + 1) % SETTINGS_COUNT;
-        displaySettingsMenu();
+        requestDisplay();
     }
     else if (currentState == TEST_MACHINE)
     {
         currentMenuIndex = (currentMenuIndex + 1) % TEST_COUNT;
-        displayTestMenu();
+        requestDisplay();
     }
     else if (currentState == EDIT_TIMER)
     {
-        timerEditValue -= 1000; // Decrease by 1 second
-        if (timerEditValue < MIN_TIMER_VALUE)
+        unsigned long step = editStep();
+        if (timerEditValue < MIN_TIMER_VALUE + step)
             timerEditValue = MIN_TIMER_VALUE;
-        displayTimerEdit();
+        else
+            timerEditValue -= step;
+        requestDisplay();
+    }
+    else if (currentState == RESUME_PROMPT)
+    {
+        currentMenuIndex = (currentMenuIndex + 1) % RESUME_COUNT;
+        requestDisplay();
     }
 }
 
-void MouldBotController::onEnterPressed()
+template <typename Relays>
+void MouldBotController<Relays>::onEnterPressed()
 {
     if (currentState == MAIN_MENU)
     {
@@ -213,7 +746,7 @@ void MouldBotController::onEnterPressed()
         case SETTINGS:
             currentState = SETTINGS_MENU;
             currentMenuIndex = 0;
-            displaySettingsMenu();
+            requestDisplay();
             break;
         case RUN_AUTO_OPTION:
             startAutoRun();
@@ -221,7 +754,11 @@ void MouldBotController::onEnterPressed()
         case TEST_MACHINE_OPTION:
             currentState = TEST_MACHINE;
             currentMenuIndex = 0;
-            displayTestMenu();
+            requestDisplay();
+            break;
+        case ENERGY_OPTION:
+            currentState = ENERGY_VIEW;
+            requestDisplay();
             break;
         }
     }
@@ -231,7 +768,7 @@ void MouldBotController::onEnterPressed()
         {
             currentState = MAIN_MENU;
             currentMenuIndex = 0;
-            displayMainMenu();
+            requestDisplay();
         }
         else
         {
@@ -243,11 +780,9 @@ void MouldBotController::onEnterPressed()
         if (currentMenuIndex == BACK_FROM_TEST)
         {
             allRelaysOff();
-            for (int i = 0; i < 5; i++)
-                relayStates[i] = false;
             currentState = MAIN_MENU;
             currentMenuIndex = 0;
-            displayMainMenu();
+            requestDisplay();
         }
         else
         {
@@ -259,50 +794,116 @@ void MouldBotController::onEnterPressed()
         saveTimerEdit();
         saveTimersToEEPROM(); // Save to EEPROM when timer is changed
         currentState = SETTINGS_MENU;
-        displaySettingsMenu();
+        requestDisplay();
     }
     else if (currentState == RUN_AUTO)
     {
         if (autoState == AUTO_MOULDING_PROMPT)
         {
-            // User pressed enter to continue moulding
-            autoState = AUTO_DOOR_OPEN;
-            stateStartTime = millis();
-            setRelay(RELAY_MIXER_DOOR, true); // Open door
-            displayAutoStatus();
+            // User pressed enter to continue moulding; unless the mixer has
+            // already run for CATCH_UP_MIX_TIME since it last started, it
+            // makes up the difference before the batch is released. A mixer
+            // that only just came back on from a rest has not stirred enough
+            if (relays.get(RELAY_CH_MIXER) && millis() - mixerOnSince >= CATCH_UP_MIX_TIME)
+            {
+                openDoor();
+            }
+            else
+            {
+                enterAutoState(AUTO_CATCH_UP_MIX);
+                if (!relays.get(RELAY_CH_MIXER))
+                {
+                    setRelay(RELAY_CH_MIXER, true);
+                }
+            }
         }
         else if (autoState == AUTO_COMPLETE)
         {
             // Return to main menu
-            autoRunning = false;
-            allRelaysOff();
+            stopAutoRun();
             currentState = MAIN_MENU;
             currentMenuIndex = 0;
-            displayMainMenu();
+            requestDisplay();
+        }
+    }
+    else if (currentState == ENERGY_VIEW)
+    {
+        currentState = MAIN_MENU;
+        requestDisplay();
+    }
+    else if (currentState == RESUME_PROMPT)
+    {
+        if (currentMenuIndex == RESUME_BATCH)
+        {
+            resumeAutoRun();
+        }
+        else
+        {
+            // Operator dumped the batch; keep the counters, drop the phase
+            autoState = AUTO_IDLE;
+            clearCheckpoint();
+            currentState = MAIN_MENU;
+            currentMenuIndex = 0;
+            requestDisplay();
         }
     }
 }
 
-void MouldBotController::displayMainMenu()
+template <typename Relays>
+void MouldBotController<Relays>::displaySplash()
 {
     lcd.clear();
     lcd.setCursor(0, 0);
-    lcd.print("==== MAIN MENU ====");
+    lcd.print("   MouldBot v1.0   ");
+    lcd.setCursor(0, 2);
+    lcd.print(" Press any button  ");
+}
 
+template <typename Relays>
+void MouldBotController<Relays>::displayStopNotice()
+{
+    lcd.clear();
     lcd.setCursor(0, 1);
-    lcd.print(currentMenuIndex == SETTINGS ? "> " : "  ");
-    lcd.print("Settings");
+    lcd.print("AUTO RUN STOPPED!");
+}
 
-    lcd.setCursor(0, 2);
-    lcd.print(currentMenuIndex == RUN_AUTO_OPTION ? "> " : "  ");
-    lcd.print("Run Auto");
+template <typename Relays>
+void MouldBotController<Relays>::displayMainMenu()
+{
+    lcd.clear();
+    lcd.setCursor(0, 0);
+    lcd.print("==== MAIN MENU ====");
 
-    lcd.setCursor(0, 3);
-    lcd.print(currentMenuIndex == TEST_MACHINE_OPTION ? "> " : "  ");
-    lcd.print("Test Machine");
+    // Three rows are visible; scroll once the cursor moves past them
+    int startIdx = currentMenuIndex > 2 ? currentMenuIndex - 2 : 0;
+
+    for (int i = 0; i < 3 && (startIdx + i) < MAIN_MENU_COUNT; i++)
+    {
+        int idx = startIdx + i;
+
+        lcd.setCursor(0, i + 1);
+        lcd.print(idx == currentMenuIndex ? "> " : "  ");
+
+        switch (idx)
+        {
+        case SETTINGS:
+            lcd.print("Settings");
+            break;
+        case RUN_AUTO_OPTION:
+            lcd.print("Run Auto");
+            break;
+        case TEST_MACHINE_OPTION:
+            lcd.print("Test Machine");
+            break;
+        case ENERGY_OPTION:
+            lcd.print("Energy");
+            break;
+        }
+    }
 }
 
-void MouldBotController::displaySettingsMenu()
+template <typename Relays>
+void MouldBotController<Relays>::displaySettingsMenu()
 {
     lcd.clear();
     lcd.setCursor(0, 0);
@@ -355,7 +956,55 @@ void MouldBotController::displaySettingsMenu()
     }
 }
 
-void MouldBotController::displayTestMenu()
+template <typename Relays>
+void MouldBotController<Relays>::displayResumePrompt()
+{
+    lcd.clear();
+    lcd.setCursor(0, 0);
+    lcd.print("== RESUME BATCH? ==");
+
+    lcd.setCursor(0, 1);
+    lcd.print(phaseName(autoState));
+    lcd.print(" ");
+    lcd.print(resumeElapsed / 1000);
+    lcd.print("s done");
+
+    lcd.setCursor(0, 2);
+    lcd.print(currentMenuIndex == RESUME_BATCH ? "> " : "  ");
+    lcd.print("Resume");
+
+    lcd.setCursor(0, 3);
+    lcd.print(currentMenuIndex == DISCARD_BATCH ? "> " : "  ");
+    lcd.print("Discard");
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::displayEnergy()
+{
+    energy.update(millis(), relays.state());
+
+    lcd.clear();
+    lcd.setCursor(0, 0);
+    lcd.print("=== ENERGY (Wh) ===");
+
+    lcd.setCursor(0, 1);
+    lcd.print("Batch:");
+    lcd.print(energy.energyWh(ENERGY_BATCH), 1);
+    lcd.print(" Mld:");
+    lcd.print(lastMouldEnergy, 1);
+
+    lcd.setCursor(0, 2);
+    lcd.print("Shift:");
+    lcd.print(energy.energyWh(ENERGY_SHIFT), 1);
+
+    lcd.setCursor(0, 3);
+    lcd.print("Total:");
+    lcd.print(energy.energyWh(ENERGY_TOTAL) / 1000.0, 1);
+    lcd.print("kWh");
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::displayTestMenu()
 {
     lcd.clear();
     lcd.setCursor(0, 0);
@@ -378,23 +1027,23 @@ void MouldBotController::displayTestMenu()
         {
         case TEST_STARCH:
             lcd.print("Starch:");
-            lcd.print(relayStates[0] ? "ON " : "OFF");
+            lcd.print(relays.get(RELAY_CH_STARCH) ? "ON " : "OFF");
             break;
         case TEST_PAPER:
             lcd.print("Paper:");
-            lcd.print(relayStates[1] ? "ON " : "OFF");
+            lcd.print(relays.get(RELAY_CH_PAPER) ? "ON " : "OFF");
             break;
         case TEST_WATER:
             lcd.print("Water:");
-            lcd.print(relayStates[2] ? "ON " : "OFF");
+            lcd.print(relays.get(RELAY_CH_WATER) ? "ON " : "OFF");
             break;
         case TEST_MIXER:
             lcd.print("Mixer:");
-            lcd.print(relayStates[3] ? "ON " : "OFF");
+            lcd.print(relays.get(RELAY_CH_MIXER) ? "ON " : "OFF");
             break;
         case TEST_DOOR:
             lcd.print("Door:");
-            lcd.print(relayStates[4] ? "OPEN" : "CLOSE");
+            lcd.print(relays.get(RELAY_CH_DOOR) ? "OPEN" : "CLOSE");
             break;
         case BACK_FROM_TEST:
             lcd.print("Back");
@@ -403,7 +1052,8 @@ void MouldBotController::displayTestMenu()
     }
 }
 
-void MouldBotController::enterTimerEdit(int timerIndex)
+template <typename Relays>
+void MouldBotController<Relays>::enterTimerEdit(int timerIndex)
 {
     editingTimer = timerIndex;
     currentState = EDIT_TIMER;
@@ -427,10 +1077,11 @@ void MouldBotController::enterTimerEdit(int timerIndex)
         break;
     }
 
-    displayTimerEdit();
+    requestDisplay();
 }
 
-void MouldBotController::displayTimerEdit()
+template <typename Relays>
+void MouldBotController<Relays>::displayTimerEdit()
 {
     lcd.clear();
     lcd.setCursor(0, 0);
@@ -462,10 +1113,11 @@ void MouldBotController::displayTimerEdit()
     lcd.print(" sec");
 
     lcd.setCursor(0, 3);
-    lcd.print("Up/Down: +/-1s");
+    lcd.print("Hold Up/Down: faster");
 }
 
-void MouldBotController::saveTimerEdit()
+template <typename Relays>
+void MouldBotController<Relays>::saveTimerEdit()
 {
     switch (editingTimer)
     {
@@ -488,45 +1140,109 @@ void MouldBotController::saveTimerEdit()
     editingTimer = -1;
 }
 
-void MouldBotController::toggleTestRelay(int relayIndex)
+template <typename Relays>
+void MouldBotController<Relays>::toggleTestRelay(int relayIndex)
 {
-    relayStates[relayIndex] = !relayStates[relayIndex];
-
-    switch (relayIndex)
-    {
-    case TEST_STARCH:
-        setRelay(RELAY_STARCH_FEEDER, relayStates[relayIndex]);
-        break;
-    case TEST_PAPER:
-        setRelay(RELAY_PAPER_SHREDDER, relayStates[relayIndex]);
-        break;
-    case TEST_WATER:
-        setRelay(RELAY_WATER_PUMP, relayStates[relayIndex]);
-        break;
-    case TEST_MIXER:
-        setRelay(RELAY_MIXER, relayStates[relayIndex]);
-        break;
-    case TEST_DOOR:
-        setRelay(RELAY_MIXER_DOOR, relayStates[relayIndex]);
-        break;
-    }
+    // Test menu entries line up with the relay channels
+    setRelay(relayIndex, !relays.get(relayIndex));
 
-    displayTestMenu();
+    requestDisplay();
 }
 
-void MouldBotController::startAutoRun()
+template <typename Relays>
+void MouldBotController<Relays>::startAutoRun()
 {
     currentState = RUN_AUTO;
     autoRunning = true;
     autoState = AUTO_MIXER_PREP;
+    batchCount++;
+    mouldCount = 0;
+    lastMouldEnergy = 0;
+    energy.resetScope(ENERGY_BATCH, millis());
+    energy.resetScope(ENERGY_MOULD, millis());
+    allRelaysOff();
+
+    // Prep is timed from when the mixer starts, not from before the relay reset
     stateStartTime = millis();
+    stateStartMicros = micros();
+    batchRunTime = 0;
+
+    setRelay(RELAY_CH_MIXER, true); // Turn on mixer for prep
+    requestDisplay();
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::stopAutoRun()
+{
+    doseTimer.disarm();
+    autoRunning = false;
+    autoState = AUTO_IDLE;
     allRelaysOff();
+    clearCheckpoint();
+    saveEnergyToEEPROM();
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::resumeAutoRun()
+{
+    currentState = RUN_AUTO;
+    autoRunning = true;
+    allRelaysOff();
+
+    // Mixer runs from prep until the batch is stopped; a resumed prompt
+    // wait starts a fresh agitation grace period
+    setRelay(RELAY_CH_MIXER, true);
+
+    // Plateau detection restarts from scratch on a resumed mix
+    restartMixPlateau();
+
+    // Backdate the phase start so only the remaining dose time is run. As
+    // in enterAutoState(), it is stamped before the phase relay switches,
+    // so neither the mixer's settle delay nor its own is added to the dose
+    stateStartTime = millis() - resumeElapsed;
+    stateStartMicros = micros() - resumeElapsed * 1000;
+    restoreAutoOutputs();
+    lastCheckpointTime = millis();
+    requestDisplay();
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::restartMixPlateau()
+{
+    mixerCurrent.flush();
+    mixPlateau.reset();
 
-    setRelay(RELAY_MIXER, true); // Turn on mixer for prep
-    displayAutoStatus();
+    // Marks where a captured trace starts, so plateau_test can replay
+    // each mix against a fresh detector
+    if (ctStreaming)
+        Serial.println(F("ct start"));
 }
 
-void MouldBotController::handleAutoSequence()
+template <typename Relays>
+void MouldBotController<Relays>::restoreAutoOutputs()
+{
+    // The relay the interrupted phase was running, besides the mixer
+    switch (autoState)
+    {
+    case AUTO_PAPER_SHREDDER:
+        setRelay(RELAY_CH_PAPER, true);
+        break;
+    case AUTO_STARCH_FEEDER:
+        setRelay(RELAY_CH_STARCH, true);
+        break;
+    case AUTO_WATER_PUMP:
+        setRelay(RELAY_CH_WATER, true);
+        break;
+    case AUTO_DOOR_OPEN:
+        setRelay(RELAY_CH_DOOR, true);
+        break;
+    default:
+        break;
+    }
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::handleAutoSequence()
 {
     unsigned long currentTime = millis();
     unsigned long elapsed = currentTime - stateStartTime;
@@ -539,75 +1255,94 @@ void MouldBotController::handleAutoSequence()
     case AUTO_MIXER_PREP:
         if (elapsed >= MIXER_PREP_TIME)
         {
-            autoState = AUTO_PAPER_SHREDDER;
-            stateStartTime = currentTime;
-            setRelay(RELAY_PAPER_SHREDDER, true);
-            displayAutoStatus();
+            enterAutoState(AUTO_PAPER_SHREDDER);
+            setRelay(RELAY_CH_PAPER, true);
         }
         break;
 
     case AUTO_PAPER_SHREDDER:
-        if (elapsed >= timers.paperOnTime)
+        if (doseComplete(RELAY_CH_PAPER, timers.paperOnTime))
         {
-            setRelay(RELAY_PAPER_SHREDDER, false);
             delay(100);  // Delay between relay switches
-            autoState = AUTO_STARCH_FEEDER;
-            stateStartTime = currentTime;
-            setRelay(RELAY_STARCH_FEEDER, true);
-            displayAutoStatus();
+            enterAutoState(AUTO_STARCH_FEEDER);
+            setRelay(RELAY_CH_STARCH, true);
         }
         break;
 
     case AUTO_STARCH_FEEDER:
-        if (elapsed >= timers.starchOnTime)
+        if (doseComplete(RELAY_CH_STARCH, timers.starchOnTime))
         {
-            setRelay(RELAY_STARCH_FEEDER, false);
             delay(100);  // Delay between relay switches
-            autoState = AUTO_WATER_PUMP;
-            stateStartTime = currentTime;
-            setRelay(RELAY_WATER_PUMP, true);
-            displayAutoStatus();
+            enterAutoState(AUTO_WATER_PUMP);
+            setRelay(RELAY_CH_WATER, true);
         }
         break;
 
     case AUTO_WATER_PUMP:
-        if (elapsed >= timers.waterPumpTime)
+        if (doseComplete(RELAY_CH_WATER, timers.waterPumpTime))
         {
-            setRelay(RELAY_WATER_PUMP, false);
-            autoState = AUTO_MIXING;
-            stateStartTime = currentTime;
-            displayAutoStatus();
+            enterAutoState(AUTO_MIXING);
+            restartMixPlateau();
         }
         break;
 
     case AUTO_MIXING:
-        if (elapsed >= timers.mixingTime)
+        while (mixerCurrent.available())
+        {
+            uint16_t level = mixerCurrent.read();
+            mixPlateau.addSample(level);
+
+            if (ctStreaming)
+            {
+                Serial.print(F("ct "));
+                Serial.println(level);
+            }
+        }
+
+        // Mix is homogeneous once the load current stops changing;
+        // mixingTime stays as the upper bound if it never settles
+        if (elapsed >= timers.mixingTime || (elapsed >= MIN_MIXING_TIME && mixPlateau.plateaued()))
         {
             // Keep mixer running, don't turn it off
-            autoState = AUTO_MOULDING_PROMPT;
-            displayAutoStatus();
+            enterAutoState(AUTO_MOULDING_PROMPT);
         }
         break;
 
     case AUTO_MOULDING_PROMPT:
         // Waiting for user to press enter
+        agitateMixer(elapsed);
+        break;
+
+    case AUTO_CATCH_UP_MIX:
+        // Timed from the mixer starting, so on-time before ENTER counts
+        if (currentTime - mixerOnSince >= CATCH_UP_MIX_TIME)
+        {
+            openDoor();
+        }
         break;
 
     case AUTO_DOOR_OPEN:
         if (elapsed >= timers.doorOpenTime)
         {
-            setRelay(RELAY_MIXER_DOOR, false);
-            autoState = AUTO_DOOR_CLOSE;
-            stateStartTime = currentTime;
-            displayAutoStatus();
+            setRelay(RELAY_CH_DOOR, false);
+            mouldCount++;
+
+            // Each mould is charged with everything since the previous one
+            lastMouldEnergy = energy.energyWh(ENERGY_MOULD);
+            energy.resetScope(ENERGY_MOULD, currentTime);
+
+            if (mouldCount > 1)
+                mouldStats.record(currentTime - lastMouldTime);
+            lastMouldTime = currentTime;
+
+            enterAutoState(AUTO_DOOR_CLOSE);
         }
         break;
 
     case AUTO_DOOR_CLOSE:
         if (elapsed >= DOOR_CLOSE_TIME)
         {
-            autoState = AUTO_MOULDING_PROMPT; // Repeat moulding
-            displayAutoStatus();
+            enterAutoState(AUTO_MOULDING_PROMPT); // Repeat moulding
         }
         break;
     case AUTO_COMPLETE:
@@ -615,66 +1350,169 @@ void MouldBotController::handleAutoSequence()
         break;
     }
 
-    // Update display every second during timed operations
-    if (autoState != AUTO_MOULDING_PROMPT && autoState != AUTO_COMPLETE)
+    // Checkpoint on every phase change; only a dose is also tracked through
+    // its run, since resuming it late over-feeds the batch. doseComplete()
+    // writes the last one before arming, and nothing is written while armed
+    if (autoRunning && !doseTimer.isArmed() &&
+        (autoState != checkpointState ||
+         (isDosePhase(autoState) && currentTime - lastCheckpointTime >= DOSE_CHECKPOINT_INTERVAL)))
     {
-        static unsigned long lastUpdate = 0;
-        if (currentTime - lastUpdate >= 1000)
-        {
-            displayAutoStatus();
-            lastUpdate = currentTime;
-        }
+        saveCheckpoint();
     }
 }
 
-void MouldBotController::displayAutoStatus()
+template <typename Relays>
+void MouldBotController<Relays>::enterAutoState(AutoState state)
+{
+    // Stamp the phase before its relay switches so settle delays are not
+    // taken out of the configured dose time
+    unsigned long currentTime = millis();
+    unsigned long phaseTime = currentTime - stateStartTime;
+    phaseStats[autoState].record(phaseTime);
+    batchRunTime += phaseTime;
+
+    autoState = state;
+    stateStartTime = currentTime;
+    stateStartMicros = micros();
+    requestDisplay();
+}
+
+template <typename Relays>
+bool MouldBotController<Relays>::doseComplete(uint8_t channel, unsigned long duration)
+{
+    if (doseTimer.fired())
+        finishDose();
+    if (!relays.get(channel))
+        return true;
+
+    // Loop passes are too coarse for the final cut-off; once the end is
+    // within reach of Timer1 it is handed to the compare interrupt
+    unsigned long doneUs = micros() - stateStartMicros;
+    unsigned long durationUs = duration * 1000;
+    if (doseTimer.isArmed() && doneUs < durationUs + DOSE_BACKSTOP * 1000UL)
+        return false;
+    if (doneUs < durationUs && durationUs - doneUs <= DOSE_ARM_WINDOW * 1000UL)
+    {
+        // Record the dose once more before it goes quiet for the deadline
+        saveCheckpoint();
+        doneUs = micros() - stateStartMicros;
+    }
+    if (doneUs >= durationUs)
+    {
+        // The loop was held past the deadline before it could be armed,
+        // or the compare never fired; the relay must not be left on
+        doseTimer.disarm();
+        setRelay(channel, false);
+        doseTimer.recordMissed();
+        return true;
+    }
+    if (durationUs - doneUs <= DOSE_ARM_WINDOW * 1000UL)
+    {
+        doseChannel = channel;
+        doseTimer.arm(durationUs - doneUs, Relays::ISR_SAFE ? &MouldBotController::cutOffDose : 0, this);
+    }
+    return false;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::finishDose()
+{
+    // Backends that can't switch from the interrupt cut off here instead,
+    // at most one loop pass late. Either way the dose is credited up to
+    // the moment its relay went off; nothing else touches the energy
+    // meter while a dose is armed. The interrupt has run and cannot run
+    // again before the next arm, so its timestamp is read as is
+    unsigned long cutMillis = millis();
+    if (Relays::ISR_SAFE)
+        cutMillis = doseCutMillis;
+    else
+        relays.set(doseChannel, false);
+    doseTimer.complete();
+    energy.update(cutMillis, relays.state());
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::cutOffDose(void *context)
+{
+    // Runs in the Timer1 compare interrupt; nothing else switches relays
+    // while a dose is armed, and stopAutoRun() disarms first
+    MouldBotController *controller = static_cast<MouldBotController *>(context);
+    controller->relays.set(controller->doseChannel, false);
+    controller->doseCutMillis = millis();
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::agitateMixer(unsigned long elapsed)
+{
+    // Continuous through the grace period, then AGITATE_ON_TIME at the end
+    // of every AGITATE_PERIOD so a long wait does not run the motor flat out
+    bool run = elapsed < AGITATE_GRACE_TIME ||
+               (elapsed - AGITATE_GRACE_TIME) % AGITATE_PERIOD >= AGITATE_PERIOD - AGITATE_ON_TIME;
+
+    if (run != relays.get(RELAY_CH_MIXER))
+    {
+        setRelay(RELAY_CH_MIXER, run);
+    }
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::openDoor()
+{
+    enterAutoState(AUTO_DOOR_OPEN);
+    setRelay(RELAY_CH_DOOR, true);
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::displayAutoStatus()
 {
     lcd.clear();
     lcd.setCursor(0, 0);
     lcd.print("=== AUTO RUNNING ===");
 
     unsigned long elapsed = millis() - stateStartTime;
-    unsigned long remaining = 0;
+    unsigned long duration = 0;
+
+    lcd.setCursor(0, 3);
+    lcd.print("Batch:");
+    lcd.print(batchCount);
+    lcd.print(" Moulds:");
+    lcd.print(mouldCount);
 
     lcd.setCursor(0, 1);
     switch (autoState)
     {
     case AUTO_IDLE:
-        lcd.print("Status: Idle");
-        remaining = 0;
+        duration = 0;
         break;
     case AUTO_MIXER_PREP:
-        lcd.print("Status: Mixer Prep");
-        remaining = (MIXER_PREP_TIME - elapsed) / 1000;
+        duration = MIXER_PREP_TIME;
         break;
     case AUTO_PAPER_SHREDDER:
-        lcd.print("Status: Paper Feed");
-        remaining = (timers.paperOnTime - elapsed) / 1000;
+        duration = timers.paperOnTime;
         break;
     case AUTO_STARCH_FEEDER:
-        lcd.print("Status: Starch Feed");
-        remaining = (timers.starchOnTime - elapsed) / 1000;
+        duration = timers.starchOnTime;
         break;
     case AUTO_WATER_PUMP:
-        lcd.print("Status: Water Pump");
-        remaining = (timers.waterPumpTime - elapsed) / 1000;
+        duration = timers.waterPumpTime;
         break;
     case AUTO_MIXING:
-        lcd.print("Status: Mixing");
-        remaining = (timers.mixingTime - elapsed) / 1000;
+        duration = timers.mixingTime;
         break;
     case AUTO_MOULDING_PROMPT:
         lcd.print("Add Mould & Press");
         lcd.setCursor(0, 2);
         lcd.print("ENTER to continue");
         return;
+    case AUTO_CATCH_UP_MIX:
+        elapsed = millis() - mixerOnSince;
+        duration = CATCH_UP_MIX_TIME;
+        break;
     case AUTO_DOOR_OPEN:
-        lcd.print("Status: Door Open");
-        remaining = (timers.doorOpenTime - elapsed) / 1000;
+        duration = timers.doorOpenTime;
         break;
     case AUTO_DOOR_CLOSE:
-        lcd.print("Status: Door Close");
-        remaining = (DOOR_CLOSE_TIME - elapsed) / 1000;
+        duration = DOOR_CLOSE_TIME;
         break;
     case AUTO_COMPLETE:
         lcd.print("Status: Complete");
@@ -683,16 +1521,51 @@ void MouldBotController::displayAutoStatus()
         return;
     }
 
-    if (autoState != AUTO_MOULDING_PROMPT)
+    lcd.print("Status: ");
+    lcd.print(phaseName(autoState));
+
+    lcd.setCursor(0, 2);
+    // A refresh can land after the phase has run out but before the
+    // sequence task switches over; never let the countdown underflow
+    unsigned long remaining = elapsed < duration ? (duration - elapsed) / 1000 : 0;
+
+    lcd.print("Time Left: ");
+    lcd.print(remaining);
+    lcd.print("s  ");
+}
+
+template <typename Relays>
+const char *MouldBotController<Relays>::phaseName(AutoState state)
+{
+    switch (state)
     {
-        lcd.setCursor(0, 2);
-        lcd.print("Time Left: ");
-        lcd.print(remaining);
-        lcd.print("s  ");
+    case AUTO_MIXER_PREP:
+        return "Mixer Prep";
+    case AUTO_PAPER_SHREDDER:
+        return "Paper Feed";
+    case AUTO_STARCH_FEEDER:
+        return "Starch Feed";
+    case AUTO_WATER_PUMP:
+        return "Water Pump";
+    case AUTO_MIXING:
+        return "Mixing";
+    case AUTO_MOULDING_PROMPT:
+        return "Moulding";
+    case AUTO_CATCH_UP_MIX:
+        return "Remixing";
+    case AUTO_DOOR_OPEN:
+        return "Door Open";
+    case AUTO_DOOR_CLOSE:
+        return "Door Close";
+    case AUTO_COMPLETE:
+        return "Complete";
+    default:
+        return "Idle";
     }
 }
 
-void MouldBotController::loadTimersFromEEPROM()
+template <typename Relays>
+void MouldBotController<Relays>::loadTimersFromEEPROM()
 {
     // Check if EEPROM has valid data
     byte magicNumber = EEPROM.read(EEPROM_MAGIC_ADDRESS);
@@ -715,6 +1588,15 @@ void MouldBotController::loadTimersFromEEPROM()
         address += sizeof(unsigned long);
 
         EEPROM.get(address, timers.doorOpenTime);
+
+        // A torn write or an older layout can leave a value out of range
+        bool repaired = repairTimer(timers.starchOnTime, DEFAULT_STARCH_TIME);
+        repaired |= repairTimer(timers.paperOnTime, DEFAULT_PAPER_TIME);
+        repaired |= repairTimer(timers.waterPumpTime, DEFAULT_WATER_TIME);
+        repaired |= repairTimer(timers.mixingTime, DEFAULT_MIXING_TIME);
+        repaired |= repairTimer(timers.doorOpenTime, DEFAULT_DOOR_TIME);
+        if (repaired)
+            saveTimersToEEPROM();
     }
     else
     {
@@ -724,7 +1606,8 @@ void MouldBotController::loadTimersFromEEPROM()
     }
 }
 
-void MouldBotController::saveTimersToEEPROM()
+template <typename Relays>
+void MouldBotController<Relays>::saveTimersToEEPROM()
 {
     // Write magic number to indicate valid data
     EEPROM.write(EEPROM_MAGIC_ADDRESS, EEPROM_MAGIC_NUMBER);
@@ -747,7 +1630,39 @@ void MouldBotController::saveTimersToEEPROM()
     EEPROM.put(address, timers.doorOpenTime);
 }
 
-void MouldBotController::setDefaultTimers()
+template <typename Relays>
+void MouldBotController<Relays>::loadLastScreen()
+{
+    if (EEPROM.read(SCREEN_ADDRESS) != SCREEN_MAGIC)
+        return;
+
+    // Only screens saveLastScreen() writes are accepted
+    byte screen = EEPROM.read(SCREEN_ADDRESS + 1);
+    if (screen == SETTINGS_MENU || screen == TEST_MACHINE || screen == ENERGY_VIEW)
+        currentState = (MenuState)screen;
+    savedScreen = currentState;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::saveLastScreen()
+{
+    // Boot never reopens an edit or restarts a run; the checkpoint covers runs
+    MenuState screen = currentState;
+    if (screen == EDIT_TIMER)
+        screen = SETTINGS_MENU;
+    else if (screen == RUN_AUTO || screen == RESUME_PROMPT)
+        screen = MAIN_MENU;
+
+    // Screen changes are operator driven and rare; cursor moves are not saved
+    if (screen == savedScreen)
+        return;
+    EEPROM.update(SCREEN_ADDRESS, SCREEN_MAGIC);
+    EEPROM.update(SCREEN_ADDRESS + 1, screen);
+    savedScreen = screen;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::setDefaultTimers()
 {
     timers.starchOnTime = DEFAULT_STARCH_TIME;
     timers.paperOnTime = DEFAULT_PAPER_TIME;
@@ -755,3 +1670,176 @@ void MouldBotController::setDefaultTimers()
     timers.mixingTime = DEFAULT_MIXING_TIME;
     timers.doorOpenTime = DEFAULT_DOOR_TIME;
 }
+
+template <typename Relays>
+bool MouldBotController<Relays>::loadCheckpoint()
+{
+    // Find the newest intact record; a slot torn by a brown-out fails its checksum
+    bool found = false;
+    AutoCheckpoint latest = AutoCheckpoint();
+
+    for (int slot = 0; slot < CHECKPOINT_SLOTS; slot++)
+    {
+        AutoCheckpoint record;
+        EEPROM.get(CHECKPOINT_BASE_ADDRESS + slot * sizeof(AutoCheckpoint), record);
+
+        if (record.magic != CHECKPOINT_MAGIC || record.checksum != recordChecksum(&record, offsetof(AutoCheckpoint, checksum)))
+            continue;
+
+        if (!found || (int)(record.sequence - latest.sequence) > 0)
+        {
+            latest = record;
+            checkpointSlot = slot;
+            found = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    checkpointSequence = latest.sequence;
+    batchCount = latest.batchCount;
+    mouldCount = latest.mouldCount;
+
+    if (latest.autoState <= AUTO_IDLE || latest.autoState >= AUTO_COMPLETE)
+        return false;
+
+    autoState = (AutoState)latest.autoState;
+    checkpointState = autoState;
+    resumeElapsed = latest.elapsed;
+    return true;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::saveCheckpoint()
+{
+    AutoCheckpoint record;
+    record.magic = CHECKPOINT_MAGIC;
+    record.sequence = ++checkpointSequence;
+    record.autoState = autoState;
+    record.elapsed = autoRunning ? millis() - stateStartTime : 0;
+    record.batchCount = batchCount;
+    record.mouldCount = mouldCount;
+    record.checksum = recordChecksum(&record, offsetof(AutoCheckpoint, checksum));
+
+    // Advance round the ring so no single slot takes every write; put() skips unchanged bytes
+    checkpointSlot = (checkpointSlot + 1) % CHECKPOINT_SLOTS;
+    EEPROM.put(CHECKPOINT_BASE_ADDRESS + checkpointSlot * sizeof(AutoCheckpoint), record);
+
+    checkpointState = autoState;
+    lastCheckpointTime = millis();
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::clearCheckpoint()
+{
+    // An idle record keeps the counters but leaves nothing to resume
+    saveCheckpoint();
+}
+
+template <typename Relays>
+byte MouldBotController<Relays>::recordChecksum(const void *record, size_t length)
+{
+    const byte *data = (const byte *)record;
+    byte sum = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        sum += data[i];
+    }
+    return ~sum;
+}
+
+template <typename Relays>
+bool MouldBotController<Relays>::isTimedPhase(AutoState state)
+{
+    return state != AUTO_IDLE && state != AUTO_MOULDING_PROMPT && state != AUTO_COMPLETE;
+}
+
+template <typename Relays>
+bool MouldBotController<Relays>::isDosePhase(AutoState state)
+{
+    return state == AUTO_PAPER_SHREDDER || state == AUTO_STARCH_FEEDER || state == AUTO_WATER_PUMP;
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::loadEnergyFromEEPROM()
+{
+    // Newest intact counter record; the sequence carries on past any stale
+    // records even when the block is reset, so the next save is newest
+    bool found = false;
+    EnergyRecord latest = EnergyRecord();
+
+    for (int slot = 0; slot < ENERGY_SLOTS; slot++)
+    {
+        EnergyRecord record;
+        EEPROM.get(ENERGY_RING_ADDRESS + slot * sizeof(EnergyRecord), record);
+
+        if (record.checksum != recordChecksum(&record, offsetof(EnergyRecord, checksum)))
+            continue;
+
+        if (!found || (int)(record.sequence - latest.sequence) > 0)
+        {
+            latest = record;
+            energySlot = slot;
+            found = true;
+        }
+    }
+    energySequence = latest.sequence;
+
+    if (EEPROM.read(ENERGY_ADDRESS) != ENERGY_MAGIC || !found)
+    {
+        // First boot: start totals from zero with the default ratings
+        saveEnergyToEEPROM();
+        return;
+    }
+
+    int address = ENERGY_ADDRESS + 1;
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        uint16_t watts;
+        EEPROM.get(address, watts);
+        address += sizeof(uint16_t);
+
+        energy.setWatts(channel, watts);
+        energy.setOnTimeSeconds(ENERGY_TOTAL, channel, latest.totalSeconds[channel]);
+        energy.setOnTimeSeconds(ENERGY_SHIFT, channel, latest.shiftSeconds[channel]);
+    }
+
+    // Shift duty carries on from the saved span; time powered off and
+    // anything after the last save drop out of both sides of the ratio
+    energy.setSpanSeconds(ENERGY_SHIFT, latest.shiftSpan, millis());
+}
+
+template <typename Relays>
+void MouldBotController<Relays>::saveEnergyToEEPROM()
+{
+    energy.update(millis(), relays.state());
+
+    // Watts only change on a WATTS command; update() leaves them unwritten
+    EEPROM.update(ENERGY_ADDRESS, ENERGY_MAGIC);
+    int address = ENERGY_ADDRESS + 1;
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        EEPROM.put(address, energy.watts(channel));
+        address += sizeof(uint16_t);
+    }
+
+    // The counters change on every save, so each goes to the next ring slot
+    EnergyRecord record;
+    record.sequence = ++energySequence;
+    for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+    {
+        record.totalSeconds[channel] = energy.onTimeSeconds(ENERGY_TOTAL, channel);
+        record.shiftSeconds[channel] = energy.onTimeSeconds(ENERGY_SHIFT, channel);
+    }
+    record.shiftSpan = energy.spanSeconds(ENERGY_SHIFT, millis());
+    record.checksum = recordChecksum(&record, offsetof(EnergyRecord, checksum));
+
+    energySlot = (energySlot + 1) % ENERGY_SLOTS;
+    EEPROM.put(ENERGY_RING_ADDRESS + energySlot * sizeof(EnergyRecord), record);
+    lastEnergySave = millis();
+}
+
+// Build the controller for the relay backend selected in Config.h
+template class MouldBotController<RelayBackend>;
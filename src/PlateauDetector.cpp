@@ -0,0 +1,65 @@
+#include "PlateauDetector.h"
+
+// EMA smoothing factor 1/2^FILTER_SHIFT; state is kept in the same scale
+#define FILTER_SHIFT 3
+
+PlateauDetector::PlateauDetector(uint16_t windowLength, uint16_t tolerance, uint8_t stableWindows, uint16_t minLevel)
+    : windowLength(windowLength), tolerance(tolerance), stableWindows(stableWindows), minLevel(minLevel)
+{
+    reset();
+}
+
+void PlateauDetector::reset()
+{
+    filtered = 0;
+    primed = false;
+    windowSamples = 0;
+    reference = 0;
+    stableCount = 0;
+}
+
+bool PlateauDetector::addSample(uint16_t sample)
+{
+    if (!primed)
+    {
+        // Seed the filter so it does not ramp up from zero
+        filtered = (uint32_t)sample << FILTER_SHIFT;
+        primed = true;
+    }
+    else
+    {
+        filtered -= filtered >> FILTER_SHIFT;
+        filtered += sample;
+    }
+
+    if (++windowSamples < windowLength)
+        return plateaued();
+    windowSamples = 0;
+
+    uint16_t current = level();
+    uint16_t change = current > reference ? current - reference : reference - current;
+
+    // Compare the window-to-window change against the tolerance of the previous level
+    if (reference > 0 && current >= minLevel && (uint32_t)change * 1000 <= (uint32_t)tolerance * reference)
+    {
+        if (stableCount < stableWindows)
+            stableCount++;
+    }
+    else
+    {
+        stableCount = 0;
+    }
+    reference = current;
+
+    return plateaued();
+}
+
+bool PlateauDetector::plateaued() const
+{
+    return stableCount >= stableWindows;
+}
+
+uint16_t PlateauDetector::level() const
+{
+    return filtered >> FILTER_SHIFT;
+}
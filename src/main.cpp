@@ -2,7 +2,7 @@
 #include "MouldBotController.h"
 
 // Global controller instance
-MouldBotController controller;
+MouldBotController<RelayBackend> controller;
 
 void setup() {
   controller.begin();
@@ -0,0 +1,27 @@
+#ifndef HOSTTEST_H
+#define HOSTTEST_H
+
+#include <stdio.h>
+
+// Check and report helpers shared by the host tests
+static int hostFailures = 0;
+
+#define CHECK(condition, ...)                                   \
+  do                                                            \
+  {                                                             \
+    if (!(condition))                                           \
+    {                                                           \
+      hostFailures++;                                           \
+      printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+      printf(__VA_ARGS__);                                      \
+      printf("\n");                                             \
+    }                                                           \
+  } while (0)
+
+static int hostTestResult(const char *name)
+{
+  printf("%s: %s\n", name, hostFailures ? "FAIL" : "PASS");
+  return hostFailures ? 1 : 0;
+}
+
+#endif // HOSTTEST_H
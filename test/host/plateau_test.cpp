@@ -0,0 +1,221 @@
+// PlateauDetector against synthetic mixer current traces, one RMS block
+// per sample as CurrentSampler delivers them, with the Config.h tuning.
+// Each case checks the sample at which plateaued() first turns true.
+//
+// Given a file, it instead replays a trace captured from the machine with
+// CT ON and reports where each mix plateaus:
+//
+//   plateau_test <trace> [expected first plateau sample]
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Config.h"
+#include "PlateauDetector.h"
+#include "HostTest.h"
+
+#define WINDOW PLATEAU_WINDOW
+#define NEVER 0
+
+static uint32_t noiseState = 1;
+
+// Deterministic +-2 count jitter, about what the RMS blocks show at rest
+static int noise()
+{
+  noiseState = noiseState * 1103515245 + 12345;
+  return (int)((noiseState >> 16) % 5) - 2;
+}
+
+// Sample count at which the detector first reports a plateau, or NEVER.
+// Once it has, it must hold for as long as the trace stays flat.
+static uint32_t firstPlateau(PlateauDetector &detector, uint16_t (*trace)(uint32_t), uint32_t samples,
+                             uint32_t flatFrom)
+{
+  uint32_t first = NEVER;
+  for (uint32_t n = 1; n <= samples; n++)
+  {
+    bool plateaued = detector.addSample(trace(n));
+    CHECK(plateaued == detector.plateaued(), "addSample() and plateaued() disagree at sample %u", n);
+    if (plateaued && first == NEVER)
+      first = n;
+    if (first != NEVER && n >= flatFrom)
+      CHECK(plateaued, "plateau dropped at sample %u", n);
+  }
+  return first;
+}
+
+// Dough thickening: 40 counts rising to 200 over 20 windows, then steady
+#define RAMP_END (20 * WINDOW)
+
+static uint16_t rampThenFlat(uint32_t n)
+{
+  int level = n < RAMP_END ? 40 + (int)(160 * n / RAMP_END) : 200;
+  return level + noise();
+}
+
+// Load that keeps climbing 3% a window, just over PLATEAU_TOLERANCE
+static uint16_t neverSettles(uint32_t n)
+{
+  double level = 50;
+  for (uint32_t window = 0; window < n / WINDOW; window++)
+    level *= 1.03;
+  double within = 1 + 0.03 * (n % WINDOW) / WINDOW;
+  return (uint16_t)(level * within) + noise();
+}
+
+// Motor idling below PLATEAU_MIN_LEVEL, then loaded and steady
+#define LOAD_AT (20 * WINDOW)
+
+static uint16_t unloadedThenLoaded(uint32_t n)
+{
+  int level = n < LOAD_AT ? PLATEAU_MIN_LEVEL - 6 : 120;
+  return level + noise();
+}
+
+#define MAX_MIXES 32
+
+// Replays a serial log: "ct start" begins a mix on a fresh detector, and
+// "ct <level>" or a bare number is one RMS block. Anything else the
+// controller printed is skipped. Returns the number of mixes, with the
+// first plateau sample (or NEVER) and sample count of each.
+static uint32_t replayTrace(PlateauDetector &detector, FILE *trace, uint32_t *firstPlateaus,
+                            uint32_t *sampleCounts)
+{
+  uint32_t mixes = 0;
+  bool inMix = false;
+  char line[64];
+
+  while (fgets(line, sizeof(line), trace))
+  {
+    const char *text = line;
+    if (strncmp(text, "ct start", 8) == 0)
+    {
+      inMix = false;
+      continue;
+    }
+    if (strncmp(text, "ct ", 3) == 0)
+      text += 3;
+
+    char *end;
+    unsigned long level = strtoul(text, &end, 10);
+    if (end == text || strspn(end, " \t\r\n") != strlen(end) || level > UINT16_MAX)
+      continue;
+
+    // A trace without markers is one mix
+    if (!inMix)
+    {
+      if (mixes == MAX_MIXES)
+        break;
+      detector.reset();
+      firstPlateaus[mixes] = NEVER;
+      sampleCounts[mixes] = 0;
+      mixes++;
+      inMix = true;
+    }
+
+    uint32_t n = ++sampleCounts[mixes - 1];
+    if (detector.addSample(level) && firstPlateaus[mixes - 1] == NEVER)
+      firstPlateaus[mixes - 1] = n;
+  }
+  return mixes;
+}
+
+static int replayMain(PlateauDetector &detector, const char *path, const char *expectedArg)
+{
+  FILE *trace = fopen(path, "r");
+  if (!trace)
+  {
+    perror(path);
+    return 2;
+  }
+
+  uint32_t firstPlateaus[MAX_MIXES];
+  uint32_t sampleCounts[MAX_MIXES];
+  uint32_t mixes = replayTrace(detector, trace, firstPlateaus, sampleCounts);
+  fclose(trace);
+  CHECK(mixes > 0, "no RMS blocks in %s", path);
+
+  for (uint32_t i = 0; i < mixes; i++)
+  {
+    printf("mix %u: %u samples, first plateau at sample %u%s\n", i + 1, sampleCounts[i], firstPlateaus[i],
+           firstPlateaus[i] == NEVER ? " (never)" : "");
+
+    // A recorded plateau is only known to within the window it fell in
+    if (expectedArg)
+    {
+      uint32_t expected = strtoul(expectedArg, NULL, 10);
+      CHECK(firstPlateaus[i] != NEVER && firstPlateaus[i] + WINDOW >= expected &&
+                firstPlateaus[i] <= expected + WINDOW,
+            "mix %u plateaued at %u, expected %u", i + 1, firstPlateaus[i], expected);
+    }
+  }
+  return hostTestResult("plateau replay");
+}
+
+int main(int argc, char **argv)
+{
+  PlateauDetector detector(PLATEAU_WINDOW, PLATEAU_TOLERANCE, PLATEAU_STABLE_WINDOWS, PLATEAU_MIN_LEVEL);
+
+  if (argc > 1)
+    return replayMain(detector, argv[1], argc > 2 ? argv[2] : NULL);
+
+  // The first window after the ramp already compares flat, so the
+  // plateau is reported PLATEAU_STABLE_WINDOWS windows after it ends;
+  // the filter's lag can cost one window more
+  uint32_t first = firstPlateau(detector, rampThenFlat, 60 * WINDOW, RAMP_END + 7 * WINDOW);
+  printf("ramp then plateau: first plateau at sample %u (ramp ends at %u)\n", first, RAMP_END);
+  CHECK(first >= RAMP_END + PLATEAU_STABLE_WINDOWS * WINDOW, "plateau at %u, before the level settled", first);
+  CHECK(first <= RAMP_END + (PLATEAU_STABLE_WINDOWS + 1) * WINDOW, "plateau at %u, too late", first);
+
+  detector.reset();
+  first = firstPlateau(detector, neverSettles, 60 * WINDOW, UINT32_MAX);
+  printf("never settling: first plateau at sample %u\n", first);
+  CHECK(first == NEVER, "plateau at %u on a load still climbing", first);
+
+  // Steady but unloaded never counts; the window that sees the load come
+  // on is a change, so the count starts from the one after it
+  detector.reset();
+  first = firstPlateau(detector, unloadedThenLoaded, 60 * WINDOW, LOAD_AT + 8 * WINDOW);
+  printf("below min level: first plateau at sample %u (load at %u)\n", first, LOAD_AT);
+  CHECK(first != NEVER && first > LOAD_AT, "plateau at %u while below PLATEAU_MIN_LEVEL", first);
+  CHECK(first == LOAD_AT + (PLATEAU_STABLE_WINDOWS + 1) * WINDOW, "plateau at %u after the load came on", first);
+
+  // reset() drops a plateau already found
+  detector.reset();
+  CHECK(!detector.plateaued(), "plateau survived reset()");
+
+  // Replay the first and third cases as the controller would log them
+  // with CT ON, between other replies, and expect the same answers
+  FILE *log = tmpfile();
+  CHECK(log != NULL, "no temporary file for the replay");
+  if (log)
+  {
+    fprintf(log, "OK\r\nct start\r\n");
+    for (uint32_t n = 1; n <= 60 * WINDOW; n++)
+    {
+      fprintf(log, "ct %u\r\n", rampThenFlat(n));
+      if (n == 30 * WINDOW)
+        fprintf(log, "Q t=120000 st=3 ph=5\r\n");
+    }
+    fprintf(log, "ct start\r\n");
+    for (uint32_t n = 1; n <= 60 * WINDOW; n++)
+      fprintf(log, "ct %u\r\n", unloadedThenLoaded(n));
+    rewind(log);
+
+    uint32_t firstPlateaus[MAX_MIXES] = {};
+    uint32_t sampleCounts[MAX_MIXES] = {};
+    uint32_t mixes = replayTrace(detector, log, firstPlateaus, sampleCounts);
+    fclose(log);
+    printf("replayed log: %u mixes, first plateaus at samples %u and %u\n", mixes, firstPlateaus[0],
+           firstPlateaus[1]);
+    CHECK(mixes == 2, "replay found %u mixes", mixes);
+    CHECK(sampleCounts[0] == 60 * WINDOW && sampleCounts[1] == 60 * WINDOW, "replay dropped samples");
+    CHECK(firstPlateaus[0] >= RAMP_END + PLATEAU_STABLE_WINDOWS * WINDOW &&
+              firstPlateaus[0] <= RAMP_END + (PLATEAU_STABLE_WINDOWS + 1) * WINDOW,
+          "replayed ramp plateaued at %u", firstPlateaus[0]);
+    CHECK(firstPlateaus[1] == LOAD_AT + (PLATEAU_STABLE_WINDOWS + 1) * WINDOW,
+          "replayed load plateaued at %u", firstPlateaus[1]);
+  }
+
+  return hostTestResult("plateau");
+}
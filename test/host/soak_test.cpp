@@ -0,0 +1,475 @@
+// Soak test: drives the controller on an in-memory relay backend through
+// 100k+ moulds at accelerated speed, across several millis() wraps, and
+// checks phase timing, hangs and memory growth. Built once per backend:
+// soak_test cuts doses off in the Timer1 interrupt, soak_deferred_test
+// from the loop pass after it, as on the PCF8575.
+
+#include <malloc.h>
+#include <time.h>
+#include <EEPROM.h>
+#include "MouldBotController.h"
+#include "HostSim.h"
+#include "HostTest.h"
+
+typedef MouldBotController<RelayBackend> Controller;
+
+#define SOAK_MOULDS 100000UL
+#define SOAK_BATCH_MOULDS 100        // Each batch ends with an emergency stop
+#define SOAK_WRAP_EVERY 25000UL      // Moulds between waits that run up to a millis() wrap
+#define SOAK_LONG_WAIT_ONE_IN 20     // Prompt waits long enough to rest the mixer
+#define BUSY_STEP_US 1000ULL         // Mean loop pass period while the machine is working
+#define IDLE_STEP_US 1000000ULL      // Mean loop pass period while it is parked
+#define BUTTON_MS 200                // Press and release time; covers the debounce plus relay settle delays
+
+// A timed phase may end up to one millis() tick early (its start is
+// truncated) and one sequence task pass plus one loop step late. Doses
+// are cut off by the Timer1 compare to within two 16 us ticks, or when
+// deferred, up to one loop step after that.
+#define EARLY_TOLERANCE_US 1000
+#define LATE_TOLERANCE_US (SEQUENCE_TASK_PERIOD * 1000 + BUSY_STEP_US * 3 / 2)
+#define DOSE_TOLERANCE_US (2 * DOSE_TIMER_TICK_US)
+#if RELAY_BACKEND == RELAY_BACKEND_MEMORY_DEFERRED
+#define DOSE_LATE_TOLERANCE_US (DOSE_TOLERANCE_US + BUSY_STEP_US * 3 / 2)
+#else
+#define DOSE_LATE_TOLERANCE_US DOSE_TOLERANCE_US
+#endif
+#define HANG_MARGIN_US 1000000ULL
+#define WAIT_LIMIT_US 60000000ULL    // Longest wait for a phase the test is driving towards
+
+#define MILLIS_WRAP_US (4294967296ULL * 1000)
+
+struct ControllerProbe {
+  static const uint8_t MAIN_MENU = Controller::MAIN_MENU;
+  static const uint8_t AUTO_MIXER_PREP = Controller::AUTO_MIXER_PREP;
+  static const uint8_t AUTO_MIXING = Controller::AUTO_MIXING;
+  static const uint8_t AUTO_MOULDING_PROMPT = Controller::AUTO_MOULDING_PROMPT;
+  static const uint8_t AUTO_CATCH_UP_MIX = Controller::AUTO_CATCH_UP_MIX;
+  static const uint8_t AUTO_DOOR_OPEN = Controller::AUTO_DOOR_OPEN;
+  static const uint8_t AUTO_DOOR_CLOSE = Controller::AUTO_DOOR_CLOSE;
+  static const uint8_t PHASE_COUNT = Controller::AUTO_COMPLETE + 1;
+
+  static uint8_t phase(const Controller &c) { return c.autoState; }
+  static bool running(const Controller &c) { return c.autoRunning; }
+  static uint8_t screen(const Controller &c) { return c.currentState; }
+  static uint8_t outputs(const Controller &c) { return c.relays.outputState(); }
+  static unsigned int moulds(const Controller &c) { return c.mouldCount; }
+  static unsigned int checkpoints(const Controller &c) { return c.checkpointSequence; }
+  static unsigned int energySaves(const Controller &c) { return c.energySequence; }
+  static const char *lcdLine(const Controller &c, uint8_t row) { return c.lcd.line(row); }
+  static uint32_t lcdTransfers(const Controller &c) { return c.lcd.transfers; }
+  static bool doseArmed(const Controller &c) { return c.doseTimer.isArmed(); }
+  static const DoseTimer &doseTimer(const Controller &c) { return c.doseTimer; }
+
+  // Expected length of a phase in ms, 0 if it has none; the most a
+  // remix can take, since mixer on-time before ENTER counts towards it
+  static uint64_t phaseTime(const Controller &c, uint8_t phase)
+  {
+    switch (phase)
+    {
+    case Controller::AUTO_MIXER_PREP:
+      return MIXER_PREP_TIME;
+    case Controller::AUTO_MIXING:
+      return c.timers.mixingTime;
+    case Controller::AUTO_CATCH_UP_MIX:
+      return CATCH_UP_MIX_TIME;
+    case Controller::AUTO_DOOR_OPEN:
+      return c.timers.doorOpenTime;
+    case Controller::AUTO_DOOR_CLOSE:
+      return DOOR_CLOSE_TIME;
+    default:
+      return 0;
+    }
+  }
+
+  // Expected on-time of a dose relay in ms, 0 if the channel is not dosed
+  static uint64_t doseTime(const Controller &c, uint8_t channel)
+  {
+    switch (channel)
+    {
+    case RELAY_CH_PAPER:
+      return c.timers.paperOnTime;
+    case RELAY_CH_STARCH:
+      return c.timers.starchOnTime;
+    case RELAY_CH_WATER:
+      return c.timers.waterPumpTime;
+    default:
+      return 0;
+    }
+  }
+
+  static bool isDosePhase(uint8_t phase)
+  {
+    return phase == Controller::AUTO_PAPER_SHREDDER || phase == Controller::AUTO_STARCH_FEEDER ||
+           phase == Controller::AUTO_WATER_PUMP;
+  }
+
+  static bool waitsForOperator(uint8_t phase)
+  {
+    return phase == Controller::AUTO_IDLE || phase == Controller::AUTO_MOULDING_PROMPT ||
+           phase == Controller::AUTO_COMPLETE;
+  }
+};
+
+// Signed error of observed against expected durations, in us
+struct ErrorRange {
+  uint32_t count;
+  int64_t least;
+  int64_t most;
+
+  void record(int64_t error)
+  {
+    if (count == 0 || error < least)
+      least = error;
+    if (count == 0 || error > most)
+      most = error;
+    count++;
+  }
+};
+
+static Controller controller;
+
+static uint8_t lastOutputs;
+static uint64_t relayOnAt[RELAY_CH_COUNT];
+static uint8_t lastPhase;
+static uint64_t phaseAt;
+static ErrorRange phaseErrors[ControllerProbe::PHASE_COUNT];
+static ErrorRange doseErrors[RELAY_CH_COUNT];
+static ErrorRange doorErrors;
+static bool wasArmed;
+static uint32_t armedLcd;
+static uint32_t armedEeprom;
+static uint32_t armedCommands;   // Sent as a dose was armed
+static uint32_t commandsAnswered;
+static bool commandPending;
+static bool hung;
+static uint64_t passes;
+static uint64_t idleUs;          // Time parked waiting for a wrap
+
+static uint32_t randomState = 12345;
+
+static uint32_t nextRandom()
+{
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+static uint64_t randomBetween(uint64_t low, uint64_t high)
+{
+  return low + nextRandom() % (high - low + 1);
+}
+
+// Runs at every instant simulated time passes, so edges are timed exactly
+static void observe()
+{
+  uint8_t outputs = ControllerProbe::outputs(controller);
+  uint8_t changed = outputs ^ lastOutputs;
+  for (uint8_t channel = 0; channel < RELAY_CH_COUNT; channel++)
+  {
+    if (!(changed & _BV(channel)))
+      continue;
+    if (outputs & _BV(channel))
+    {
+      relayOnAt[channel] = hostMicros;
+      continue;
+    }
+
+    int64_t onTime = hostMicros - relayOnAt[channel];
+    uint64_t dose = ControllerProbe::doseTime(controller, channel);
+    if (dose)
+      doseErrors[channel].record(onTime - (int64_t)dose * 1000);
+    else if (channel == RELAY_CH_DOOR)
+      doorErrors.record(onTime - (int64_t)ControllerProbe::phaseTime(controller, ControllerProbe::AUTO_DOOR_OPEN) * 1000);
+  }
+  lastOutputs = outputs;
+
+  // Nothing may stand between an armed deadline and the pass that serves it
+  bool armed = ControllerProbe::doseArmed(controller);
+  uint32_t lcd = ControllerProbe::lcdTransfers(controller);
+  static char serialOut[256];
+  size_t printed = hostSerialOutput(serialOut, sizeof(serialOut));
+  if (armed && wasArmed)
+  {
+    CHECK(lcd == armedLcd, "LCD written with a dose armed at t=%" PRIu64 " ms", (hostMicros / 1000));
+    CHECK(EEPROM.totalWrites == armedEeprom, "EEPROM written with a dose armed at t=%" PRIu64 " ms",
+          (hostMicros / 1000));
+    CHECK(printed == 0, "command answered with a dose armed at t=%" PRIu64 " ms", (hostMicros / 1000));
+  }
+  else if (printed && commandPending)
+  {
+    commandPending = false;
+    commandsAnswered++;
+  }
+
+  // A command arriving with the dose armed must wait; one saves to EEPROM,
+  // the other prints far more than the TX buffer holds
+  if (armed && !wasArmed)
+  {
+    hostSerialInput(armedCommands % 2 ? "ENERGY\n" : "WATTS 5 0\n");
+    armedCommands++;
+    commandPending = true;
+  }
+  wasArmed = armed;
+  armedLcd = lcd;
+  armedEeprom = EEPROM.totalWrites;
+
+  uint8_t phase = ControllerProbe::phase(controller);
+  if (phase != lastPhase)
+  {
+    // The door only opens once the mixer has run CATCH_UP_MIX_TIME since
+    // it last started, whether or not a remix was needed to get there
+    bool mixerOn = outputs & _BV(RELAY_CH_MIXER);
+    int64_t mixerOnTime = hostMicros - relayOnAt[RELAY_CH_MIXER];
+    if (phase == ControllerProbe::AUTO_DOOR_OPEN)
+      CHECK(mixerOn && mixerOnTime >= (int64_t)CATCH_UP_MIX_TIME * 1000 - EARLY_TOLERANCE_US,
+            "door opened after %" PRId64 " ms of mixing at t=%" PRIu64 " ms", (mixerOn ? mixerOnTime / 1000 : 0),
+            (hostMicros / 1000));
+
+    uint64_t expected = ControllerProbe::phaseTime(controller, lastPhase);
+    if (lastPhase == ControllerProbe::AUTO_CATCH_UP_MIX)
+      phaseErrors[lastPhase].record(mixerOnTime - (int64_t)expected * 1000);
+    else if (expected)
+      phaseErrors[lastPhase].record((int64_t)(hostMicros - phaseAt) - (int64_t)expected * 1000);
+    lastPhase = phase;
+    phaseAt = hostMicros;
+  }
+}
+
+// A phase with a timer that outlives it by a second is stuck
+static void checkHang()
+{
+  uint8_t phase = ControllerProbe::phase(controller);
+  if (ControllerProbe::waitsForOperator(phase))
+    return;
+
+  uint64_t limit = ControllerProbe::phaseTime(controller, phase);
+  if (ControllerProbe::isDosePhase(phase))
+    limit = ControllerProbe::doseTime(controller, RELAY_CH_PAPER) +
+            ControllerProbe::doseTime(controller, RELAY_CH_STARCH) +
+            ControllerProbe::doseTime(controller, RELAY_CH_WATER);
+  if (hostMicros - phaseAt > limit * 1000 + HANG_MARGIN_US && !hung)
+  {
+    hung = true;
+    CHECK(false, "phase %u stuck for %" PRIu64 " ms at t=%" PRIu64 " ms", phase,
+          ((hostMicros - phaseAt) / 1000), (hostMicros / 1000));
+  }
+}
+
+static void pass(uint64_t step)
+{
+  controller.update();
+  observe();
+  checkHang();
+
+  // Loop passes jitter around the step so phase ends do not line up with ticks
+  hostAdvance(randomBetween(step / 2, step + step / 2));
+  passes++;
+}
+
+static void run(uint64_t us, uint64_t step)
+{
+  uint64_t end = hostMicros + us;
+  while (hostMicros < end && !hung)
+    pass(step);
+}
+
+// Also catches a prompt that ignores the operator
+static void runUntilPhase(uint8_t phase)
+{
+  uint64_t start = hostMicros;
+  while (ControllerProbe::phase(controller) != phase && !hung)
+  {
+    pass(BUSY_STEP_US);
+    if (hostMicros - start > WAIT_LIMIT_US)
+    {
+      hung = true;
+      CHECK(false, "phase %u not reached, still in %u at t=%" PRIu64 " ms", phase,
+            ControllerProbe::phase(controller), hostMicros / 1000);
+    }
+  }
+}
+
+static void press(uint8_t pin)
+{
+  hostPress(pin, true);
+  run(BUTTON_MS * 1000ULL, BUSY_STEP_US);
+  hostPress(pin, false);
+  run(BUTTON_MS * 1000ULL, BUSY_STEP_US);
+}
+
+static void startBatch()
+{
+  // Main menu cursor is on Settings; Run Auto is one down
+  press(BTN_DOWN);
+  press(BTN_ENTER);
+  CHECK(ControllerProbe::running(controller), "auto run did not start");
+}
+
+static void emergencyStop()
+{
+  hostPress(BTN_UP, true);
+  hostPress(BTN_ENTER, true);
+  hostPress(BTN_DOWN, true);
+  run(BUTTON_MS * 1000ULL, BUSY_STEP_US);
+
+  CHECK(!ControllerProbe::running(controller), "emergency stop left the run going");
+  CHECK(ControllerProbe::outputs(controller) == 0, "relays 0x%02x left on after stop",
+        ControllerProbe::outputs(controller));
+  CHECK(strstr(ControllerProbe::lcdLine(controller, 1), "AUTO RUN STOPPED!"), "no stop notice: '%s'",
+        ControllerProbe::lcdLine(controller, 1));
+
+  hostPress(BTN_UP, false);
+  hostPress(BTN_ENTER, false);
+  hostPress(BTN_DOWN, false);
+  run(STOP_NOTICE_TIMEOUT * 1000ULL, BUSY_STEP_US);
+
+  CHECK(ControllerProbe::screen(controller) == ControllerProbe::MAIN_MENU, "stop did not return to the main menu");
+  CHECK(strstr(ControllerProbe::lcdLine(controller, 0), "MAIN MENU"), "stop notice not dismissed: '%s'",
+        ControllerProbe::lcdLine(controller, 0));
+}
+
+// Parks the machine until `ahead` us before the next millis() wrap
+static void idleToWrap(uint64_t ahead)
+{
+  uint64_t wrap = (hostMicros / MILLIS_WRAP_US + 1) * MILLIS_WRAP_US;
+  uint64_t parked = hostMicros;
+  run(wrap - ahead - hostMicros, IDLE_STEP_US);
+  idleUs += hostMicros - parked;
+}
+
+static void mould(uint32_t done)
+{
+  runUntilPhase(ControllerProbe::AUTO_MOULDING_PROMPT);
+
+  // Mostly prompt answers within the agitation grace period; every so
+  // often a wait long enough for the mixer to rest and need a remix
+  if (nextRandom() % SOAK_LONG_WAIT_ONE_IN == 0)
+    run(randomBetween(AGITATE_GRACE_TIME, AGITATE_GRACE_TIME + 2 * AGITATE_PERIOD) * 1000, IDLE_STEP_US);
+  else
+    run(randomBetween(0, 2000) * 1000, BUSY_STEP_US);
+
+  // Mid-batch wraps land while the door cycles
+  if (done % SOAK_WRAP_EVERY == SOAK_WRAP_EVERY / 2)
+    idleToWrap(randomBetween(0, ControllerProbe::phaseTime(controller, ControllerProbe::AUTO_DOOR_OPEN) + DOOR_CLOSE_TIME) * 1000);
+
+  press(BTN_ENTER);
+  runUntilPhase(ControllerProbe::AUTO_DOOR_CLOSE);
+}
+
+static void report(const char *name, const ErrorRange &range, int64_t early, int64_t late)
+{
+  printf("  %-12s %7u  %+8.3f .. %+8.3f ms\n", name, range.count, range.least / 1000.0, range.most / 1000.0);
+  CHECK(range.count > 0, "%s never ran", name);
+  CHECK(range.least >= -early && range.most <= late, "%s outside %+.3f .. %+.3f ms", name,
+        -early / 1000.0, late / 1000.0);
+}
+
+static uint32_t maxWrites(int first, int last)
+{
+  uint32_t most = 0;
+  for (int address = first; address < last; address++)
+  {
+    if (EEPROM.writes[address] > most)
+      most = EEPROM.writes[address];
+  }
+  return most;
+}
+
+int main(int argc, char **argv)
+{
+  // A shorter run can be asked for while debugging
+  uint32_t target = argc > 1 ? strtoul(argv[1], 0, 10) : SOAK_MOULDS;
+
+  // Boot a few seconds before the first wrap so the first doses straddle it
+  hostReset(MILLIS_WRAP_US - 5000000ULL);
+  uint64_t bootAt = hostMicros;
+
+  // Short timers keep the simulated run to a few days of machine time. The
+  // water dose puts a countdown refresh inside its armed window
+  EEPROM.write(EEPROM_MAGIC_ADDRESS, EEPROM_MAGIC_NUMBER);
+  const unsigned long soakTimers[5] = {1000, 2000, 2200, 3000, 1000};  // Starch, paper, water, mixing, door
+  EEPROM.put(EEPROM_DATA_ADDRESS, soakTimers);
+
+  controller.begin();
+  hostObserver = observe;
+  run(SPLASH_TIMEOUT * 1000ULL + 100000, BUSY_STEP_US);
+
+  char discard[256];
+  hostSerialOutput(discard, sizeof(discard));
+  printf("soak: %u moulds in batches of %d\n", target, SOAK_BATCH_MOULDS);
+
+  // The controller allocates nothing; anything on the heap after this is growth
+  struct mallinfo2 heapBefore = mallinfo2();
+  clock_t hostStart = clock();
+
+  uint32_t moulds = 0;
+  uint32_t batches = 0;
+  while (moulds < target && !hung)
+  {
+    startBatch();
+    batches++;
+    for (int i = 0; i < SOAK_BATCH_MOULDS && !hung; i++)
+    {
+      mould(++moulds);
+      CHECK(ControllerProbe::moulds(controller) == (unsigned)i + 1, "mould count %u, expected %d",
+            ControllerProbe::moulds(controller), i + 1);
+    }
+    runUntilPhase(ControllerProbe::AUTO_MOULDING_PROMPT);
+    emergencyStop();
+
+    // Some batch starts land on a wrap, so the doses straddle it
+    if (moulds % SOAK_WRAP_EVERY == 0)
+      idleToWrap(randomBetween(0, MIXER_PREP_TIME + 4500) * 1000);
+  }
+
+  double hostSeconds = (double)(clock() - hostStart) / CLOCKS_PER_SEC;
+  struct mallinfo2 heapAfter = mallinfo2();
+  uint64_t wraps = hostMicros / MILLIS_WRAP_US - bootAt / MILLIS_WRAP_US;
+  double simulatedHours = (hostMicros - bootAt) / 3.6e9;
+  double workingHours = (hostMicros - bootAt - idleUs) / 3.6e9;
+
+  printf("phase error (observed - set)\n");
+  report("mixer prep", phaseErrors[ControllerProbe::AUTO_MIXER_PREP], EARLY_TOLERANCE_US, LATE_TOLERANCE_US);
+  report("paper dose", doseErrors[RELAY_CH_PAPER], DOSE_TOLERANCE_US, DOSE_LATE_TOLERANCE_US);
+  report("starch dose", doseErrors[RELAY_CH_STARCH], DOSE_TOLERANCE_US, DOSE_LATE_TOLERANCE_US);
+  report("water dose", doseErrors[RELAY_CH_WATER], DOSE_TOLERANCE_US, DOSE_LATE_TOLERANCE_US);
+  report("mixing", phaseErrors[ControllerProbe::AUTO_MIXING], EARLY_TOLERANCE_US, LATE_TOLERANCE_US);
+  report("remixing", phaseErrors[ControllerProbe::AUTO_CATCH_UP_MIX], EARLY_TOLERANCE_US, LATE_TOLERANCE_US);
+  report("door relay", doorErrors, EARLY_TOLERANCE_US, LATE_TOLERANCE_US);
+  report("door close", phaseErrors[ControllerProbe::AUTO_DOOR_CLOSE], EARLY_TOLERANCE_US, LATE_TOLERANCE_US);
+  const DoseTimer &doses = ControllerProbe::doseTimer(controller);
+  printf("dose cut-offs %" PRIu32 " (%s), late %" PRIu32 "..%" PRIu32 " us, mean %" PRIu32 " us, missed %" PRIu32 "\n",
+         (uint32_t)doses.cutoffCount(), RelayBackend::ISR_SAFE ? "interrupt" : "loop", (uint32_t)doses.minLateUs(),
+         (uint32_t)doses.maxLateUs(), (uint32_t)doses.meanLateUs(), (uint32_t)doses.missedCount());
+  CHECK(doses.cutoffCount() == 3 * batches && doses.missedCount() == 0,
+        "%" PRIu32 " cut-offs and %" PRIu32 " missed in %u batches", (uint32_t)doses.cutoffCount(),
+        (uint32_t)doses.missedCount(), batches);
+  CHECK(doses.maxLateUs() <= DOSE_LATE_TOLERANCE_US, "a cut-off landed %" PRIu32 " us late",
+        (uint32_t)doses.maxLateUs());
+  printf("commands sent with a dose armed %u, answered after it %u\n", armedCommands, commandsAnswered);
+  CHECK(armedCommands > 0 && commandsAnswered >= armedCommands - 1, "commands sent while armed went unanswered");
+
+  printf("moulds %u, batches %u, millis() wraps %" PRIu64 "\n", moulds, batches, wraps);
+  printf("simulated %.1f h (%.1f h working), %.0f moulds/h working\n", simulatedHours, workingHours,
+         moulds / workingHours);
+  printf("host %.1f s: %.0f loop passes/s, %.0fx real time\n", hostSeconds, passes / hostSeconds,
+         simulatedHours * 3600 / hostSeconds);
+  uint32_t ringWrites = maxWrites(CHECKPOINT_BASE_ADDRESS, EEPROM_SIZE);
+  uint32_t laps = ControllerProbe::checkpoints(controller) / CHECKPOINT_SLOTS;
+  uint32_t energyWrites = maxWrites(ENERGY_RING_ADDRESS, ENERGY_ADDRESS);
+  uint32_t energyLaps = ControllerProbe::energySaves(controller) / ENERGY_SLOTS;
+  printf("eeprom most writes to one cell: checkpoints %u (%.1f per 1000 moulds), energy %u of %u saves, "
+         "watts %u\n", ringWrites, ringWrites * 1000.0 / moulds, energyWrites,
+         ControllerProbe::energySaves(controller), maxWrites(ENERGY_ADDRESS, CHECKPOINT_BASE_ADDRESS));
+  printf("heap in use %zu -> %zu bytes\n", heapBefore.uordblks, heapAfter.uordblks);
+
+  CHECK(moulds >= target, "only %u moulds", moulds);
+  CHECK(wraps >= 3, "only %" PRIu64 " millis() wraps", wraps);
+  CHECK(ringWrites <= laps + 1, "a ring cell took %u writes in %u laps", ringWrites, laps);
+  CHECK(energyWrites <= energyLaps + 1, "an energy cell took %u writes in %u laps", energyWrites, energyLaps);
+  CHECK(heapAfter.uordblks == heapBefore.uordblks, "heap grew by %zd bytes",
+        (ssize_t)(heapAfter.uordblks - heapBefore.uordblks));
+
+  return hostTestResult("soak");
+}
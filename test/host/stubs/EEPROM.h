@@ -0,0 +1,50 @@
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include "Arduino.h"
+
+#define HOST_EEPROM_SIZE 4096   // ATmega2560
+
+// Byte array with a write counter per cell, for wear checks. As in the
+// AVR library, put() only writes the bytes that change.
+class EEPROMClass {
+public:
+  uint8_t cells[HOST_EEPROM_SIZE];
+  uint32_t writes[HOST_EEPROM_SIZE];
+  uint32_t totalWrites;
+
+  uint8_t read(int address) { return cells[address]; }
+
+  void write(int address, uint8_t value)
+  {
+    cells[address] = value;
+    writes[address]++;
+    totalWrites++;
+  }
+
+  void update(int address, uint8_t value)
+  {
+    if (cells[address] != value)
+      write(address, value);
+  }
+
+  template <typename T> T &get(int address, T &value)
+  {
+    memcpy(&value, &cells[address], sizeof(T));
+    return value;
+  }
+
+  template <typename T> const T &put(int address, const T &value)
+  {
+    const uint8_t *bytes = (const uint8_t *)&value;
+    for (size_t i = 0; i < sizeof(T); i++)
+      update(address + i, bytes[i]);
+    return value;
+  }
+
+  uint16_t length() { return HOST_EEPROM_SIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // HOST_EEPROM_H
@@ -0,0 +1,186 @@
+#include "HostSim.h"
+#include <Wire.h>
+#include <EEPROM.h>
+
+#define HOST_PORTS 9
+#define HOST_SERIAL_BUFFER 4096
+#define HOST_TIMER1_TICK_US (256000000UL / F_CPU)
+
+volatile uint8_t PORTA;
+volatile uint8_t DDRA;
+volatile uint8_t ADMUX;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint16_t ADC;
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint8_t TIMSK1;
+volatile uint8_t TIFR1;
+volatile uint16_t OCR1A;
+
+volatile uint8_t hostPortInput[HOST_PORTS];
+
+// avr-libc heap bounds read by freeMemory()
+char __heap_start;
+char *__brkval;
+
+HardwareSerial Serial;
+TwoWire Wire;
+EEPROMClass EEPROM;
+
+uint64_t hostMicros;
+void (*hostObserver)();
+
+// Fixed rings so a long run never touches the host heap
+static char serialIn[HOST_SERIAL_BUFFER];
+static size_t serialInHead;
+static size_t serialInTail;
+static char serialOut[HOST_SERIAL_BUFFER];
+static size_t serialOutLength;
+
+unsigned long millis()
+{
+    return (unsigned long)(hostMicros / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)hostMicros;
+}
+
+void delay(unsigned long ms)
+{
+    hostAdvance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    hostAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (mode == INPUT_PULLUP)
+        hostPortInput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+}
+
+uint16_t hostTimer1Count()
+{
+    return (uint16_t)(hostMicros / HOST_TIMER1_TICK_US);
+}
+
+void hostAdvance(uint64_t us)
+{
+    uint64_t end = hostMicros + us;
+
+    if (hostObserver)
+        hostObserver();
+
+    // Stop at each compare match on the way, on the tick TCNT1 reaches OCR1A
+    while (TIMSK1 & _BV(OCIE1A))
+    {
+        uint64_t tick = hostMicros / HOST_TIMER1_TICK_US + 1;
+        uint16_t ahead = (uint16_t)(OCR1A - (uint16_t)tick);
+        uint64_t match = (tick + ahead) * HOST_TIMER1_TICK_US;
+        if (match > end)
+            break;
+
+        hostMicros = match;
+        TIFR1 |= _BV(OCF1A);
+        TIMER1_COMPA_vect();
+        if (hostObserver)
+            hostObserver();
+    }
+
+    hostMicros = end;
+}
+
+void hostReset(uint64_t startMicros)
+{
+    hostMicros = startMicros;
+    hostObserver = 0;
+    memset((void *)hostPortInput, 0, sizeof(hostPortInput));
+    TIMSK1 = 0;
+    serialInHead = 0;
+    serialInTail = 0;
+    serialOutLength = 0;
+
+    // Erased EEPROM reads 0xFF
+    memset(EEPROM.cells, 0xFF, sizeof(EEPROM.cells));
+    memset(EEPROM.writes, 0, sizeof(EEPROM.writes));
+    EEPROM.totalWrites = 0;
+}
+
+void hostPress(uint8_t pin, bool down)
+{
+    if (down)
+        hostPortInput[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin);
+    else
+        hostPortInput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+}
+
+void hostSerialInput(const char *text)
+{
+    while (*text)
+    {
+        serialIn[serialInHead] = *text++;
+        serialInHead = (serialInHead + 1) % HOST_SERIAL_BUFFER;
+    }
+}
+
+size_t hostSerialOutput(char *buffer, size_t size)
+{
+    size_t length = serialOutLength < size - 1 ? serialOutLength : size - 1;
+    memcpy(buffer, serialOut, length);
+    buffer[length] = '\0';
+    serialOutLength = 0;
+    return length;
+}
+
+int HardwareSerial::available()
+{
+    return (serialInHead + HOST_SERIAL_BUFFER - serialInTail) % HOST_SERIAL_BUFFER;
+}
+
+int HardwareSerial::read()
+{
+    if (serialInTail == serialInHead)
+        return -1;
+    char c = serialIn[serialInTail];
+    serialInTail = (serialInTail + 1) % HOST_SERIAL_BUFFER;
+    return c;
+}
+
+int HardwareSerial::availableForWrite()
+{
+    return 63;
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    // Output nobody collects is dropped once the buffer is full
+    if (serialOutLength < HOST_SERIAL_BUFFER)
+        serialOut[serialOutLength++] = value;
+    return 1;
+}
+
+size_t Print::print(long value, int base)
+{
+    char text[24];
+    snprintf(text, sizeof(text), base == HEX ? "%" PRIx32 : "%" PRId32, (int32_t)value);
+    return print((const char *)text);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    char text[24];
+    snprintf(text, sizeof(text), base == HEX ? "%" PRIx32 : "%" PRIu32, (uint32_t)value);
+    return print((const char *)text);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char text[40];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print((const char *)text);
+}
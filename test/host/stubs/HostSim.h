@@ -0,0 +1,28 @@
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+#include <Arduino.h>
+
+// Simulated machine behind the Arduino stubs.
+// Time only moves in hostAdvance(): the firmware's delay() calls it, and
+// a test drives the loop by calling update() and advancing the clock in
+// between. Timer1 counts in 16 us ticks off the same clock, and its
+// compare interrupt runs at the exact tick it would on the chip.
+
+extern uint64_t hostMicros;
+
+// Called each time simulated time is about to pass and after every
+// interrupt, so a test sees every output change at the moment it is made
+extern void (*hostObserver)();
+
+void hostAdvance(uint64_t us);
+void hostReset(uint64_t startMicros);
+
+// Buttons are active LOW with pull-ups; true holds the pin down
+void hostPress(uint8_t pin, bool down);
+
+// Serial: input is queued for read(); output is kept until taken
+void hostSerialInput(const char *text);
+size_t hostSerialOutput(char *buffer, size_t size);
+
+#endif // HOSTSIM_H
@@ -0,0 +1,56 @@
+#ifndef HOST_LIQUIDCRYSTAL_I2C_H
+#define HOST_LIQUIDCRYSTAL_I2C_H
+
+#include "Arduino.h"
+
+#define HOST_LCD_COLS 20
+#define HOST_LCD_ROWS 4
+
+// Keeps the characters on screen so tests can read them back, and counts
+// the calls that would each be an I2C transfer on the real display
+class LiquidCrystal_I2C : public Print {
+private:
+  char text[HOST_LCD_ROWS][HOST_LCD_COLS + 1];
+  uint8_t col;
+  uint8_t row;
+
+public:
+  uint32_t transfers;
+
+  LiquidCrystal_I2C(uint8_t, uint8_t, uint8_t) : transfers(0) { clear(); }
+
+  void init() { clear(); }
+  void backlight() {}
+
+  void clear()
+  {
+    for (uint8_t r = 0; r < HOST_LCD_ROWS; r++)
+    {
+      memset(text[r], ' ', HOST_LCD_COLS);
+      text[r][HOST_LCD_COLS] = '\0';
+    }
+    col = 0;
+    row = 0;
+    transfers++;
+  }
+
+  void setCursor(uint8_t c, uint8_t r)
+  {
+    col = c;
+    row = r;
+    transfers++;
+  }
+
+  virtual size_t write(uint8_t value)
+  {
+    if (row < HOST_LCD_ROWS && col < HOST_LCD_COLS)
+      text[row][col] = value;
+    col++;
+    transfers++;
+    return 1;
+  }
+
+  const char *line(uint8_t r) const { return text[r]; }
+};
+
+#endif // HOST_LIQUIDCRYSTAL_I2C_H
@@ -0,0 +1,14 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+// Vectors become plain functions; HostArduino.cpp calls them when the
+// simulated hardware would raise the interrupt
+#define ISR(vector) extern "C" void vector(void)
+
+extern "C" void TIMER1_COMPA_vect(void);
+extern "C" void ADC_vect(void);
+
+inline void cli() {}
+inline void sei() {}
+
+#endif // HOST_AVR_INTERRUPT_H
@@ -0,0 +1,47 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+// The registers the firmware touches, as plain variables. TCNT1 follows
+// the simulated clock (see HostArduino.cpp) and is read-only here.
+extern volatile uint8_t PORTA;
+extern volatile uint8_t DDRA;
+
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint16_t ADC;
+
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+extern volatile uint16_t OCR1A;
+uint16_t hostTimer1Count();
+#define TCNT1 hostTimer1Count()
+
+#define _BV(bit) (1 << (bit))
+
+// ADCSRA
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+// ADMUX / ADCSRB
+#define REFS0 6
+#define MUX5 3
+
+// Timer1
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define OCIE1A 1
+#define OCF1A 1
+
+#endif // HOST_AVR_IO_H
@@ -0,0 +1,28 @@
+#ifndef HOST32_H
+#define HOST32_H
+
+// Forced ahead of every host translation unit (-include).
+// AVR long is 32 bits: millis() wraps at 2^32 ms and the EEPROM records
+// are laid out with 4-byte longs. The Makefile builds with -m32 when the
+// toolchain has a 32-bit runtime, and then nothing is changed here.
+// Without one, the system headers are read first with their own long and
+// the firmware and stubs are then compiled with long narrowed to int.
+// Redefining a keyword is undefined behaviour, so this is a fallback: it
+// works with GCC and Clang, and firmware printf formats use the
+// <inttypes.h> macros so they stay correct either way.
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include <time.h>
+
+#if __SIZEOF_LONG__ != 4
+#define HOST32_NARROW_LONG
+#define long int
+#endif
+
+#endif // HOST32_H
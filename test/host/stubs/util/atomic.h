@@ -0,0 +1,9 @@
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+// Interrupts are only raised between firmware statements that pass
+// simulated time, never inside a block, so a block is just a scope
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (bool atomicOnce = true; atomicOnce; atomicOnce = false)
+
+#endif // HOST_UTIL_ATOMIC_H
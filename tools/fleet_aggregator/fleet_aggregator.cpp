@@ -0,0 +1,454 @@
+// Fleet aggregator: polls many MouldBot controllers over serial links with the
+// firmware's "Q" query and writes fleet throughput and per-machine bottlenecks
+// to a rolling CSV time series. Single thread, non-blocking I/O over poll().
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+// Phase indices match AutoState in MouldBotController.h; "pt=" lists
+// AUTO_MIXER_PREP up to AUTO_DOOR_CLOSE
+static const char *const PHASE_NAMES[] = {
+    "idle", "mixer_prep", "paper", "starch", "water", "mixing",
+    "prompt", "catch_up_mix", "door_open", "door_close", "complete"};
+static const int PHASE_COUNT = sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]);
+static const int FIRST_TIMED_PHASE = 1;
+static const int PHASE_TIMES = PHASE_COUNT - 2;
+
+static const int LINE_MAX_LENGTH = 256;
+static const long REOPEN_INTERVAL_MS = 5000;
+
+struct Sample
+{
+    unsigned long uptime;      // Controller millis()
+    unsigned int menuState;
+    unsigned int phase;
+    unsigned long phaseElapsed;
+    unsigned int batchCount;
+    unsigned int mouldCount;
+    unsigned long cycles;      // Completed mould cycles, monotonic until reset
+    unsigned long cycleMean;
+    unsigned long phaseMean[PHASE_TIMES];
+};
+
+struct Machine
+{
+    std::string path;
+    int fd;
+    long nextOpenTime;
+    char line[LINE_MAX_LENGTH];
+    int lineLength;
+
+    bool haveSample;
+    bool fresh;                // Answered since the last report
+    Sample last;
+    Sample baseline;           // Start of the current rate window
+    bool haveBaseline;
+    double mouldsPerHour;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int)
+{
+    running = 0;
+}
+
+static long monotonicMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+static speed_t baudConstant(long baud)
+{
+    switch (baud)
+    {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    default:
+        return B115200;
+    }
+}
+
+static void openMachine(Machine &machine, speed_t baud, long now)
+{
+    machine.fd = open(machine.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (machine.fd < 0)
+    {
+        machine.nextOpenTime = now + REOPEN_INTERVAL_MS;
+        return;
+    }
+
+    // Raw 8N1; a pty accepts the same settings. VMIN 1 makes an empty
+    // non-blocking read fail with EAGAIN, so 0 bytes really means hangup.
+    // No HUPCL, so closing the port does not drop DTR either
+    struct termios tio;
+    if (tcgetattr(machine.fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~HUPCL;
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        cfsetispeed(&tio, baud);
+        cfsetospeed(&tio, baud);
+        tcsetattr(machine.fd, TCSANOW, &tio);
+    }
+
+    // A DTR edge resets a Mega through its auto-reset capacitor. The
+    // kernel may already have raised DTR during open(), so this only stops
+    // the tool toggling it further; ptys have no modem lines and fail here
+    int lines = TIOCM_DTR | TIOCM_RTS;
+    ioctl(machine.fd, TIOCMBIC, &lines);
+
+    machine.lineLength = 0;
+    machine.haveBaseline = false;
+    fprintf(stderr, "fleet: opened %s\n", machine.path.c_str());
+}
+
+static void closeMachine(Machine &machine, long now)
+{
+    fprintf(stderr, "fleet: lost %s\n", machine.path.c_str());
+    close(machine.fd);
+    machine.fd = -1;
+    machine.nextOpenTime = now + REOPEN_INTERVAL_MS;
+    machine.fresh = false;
+}
+
+// Parses "Q t=.. st=.. ph=.. el=.. b=.. m=.. mc=.. ma=.. pt=a,b,..."
+static bool parseReply(const char *line, Sample &sample)
+{
+    if (strncmp(line, "Q ", 2) != 0)
+        return false;
+
+    memset(&sample, 0, sizeof(sample));
+    int consumed = 0;
+    if (sscanf(line, "Q t=%lu st=%u ph=%u el=%lu b=%u m=%u mc=%lu ma=%lu pt=%n",
+               &sample.uptime, &sample.menuState, &sample.phase, &sample.phaseElapsed,
+               &sample.batchCount, &sample.mouldCount, &sample.cycles, &sample.cycleMean,
+               &consumed) != 8 || consumed == 0)
+        return false;
+
+    const char *cursor = line + consumed;
+    for (int i = 0; i < PHASE_TIMES; i++)
+    {
+        char *end;
+        sample.phaseMean[i] = strtoul(cursor, &end, 10);
+        if (end == cursor)
+            return false;
+        cursor = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
+static void onSample(Machine &machine, const Sample &sample)
+{
+    // A reboot or CYCLES RESET moves the counters backwards; start a new window
+    if (machine.haveBaseline &&
+        (sample.uptime < machine.baseline.uptime || sample.cycles < machine.baseline.cycles))
+        machine.haveBaseline = false;
+
+    if (!machine.haveBaseline)
+    {
+        machine.baseline = sample;
+        machine.haveBaseline = true;
+        machine.mouldsPerHour = 0;
+    }
+    else if (sample.uptime > machine.baseline.uptime)
+    {
+        double hours = (sample.uptime - machine.baseline.uptime) / 3600000.0;
+        machine.mouldsPerHour = (sample.cycles - machine.baseline.cycles) / hours;
+    }
+
+    machine.last = sample;
+    machine.haveSample = true;
+    machine.fresh = true;
+}
+
+static void readMachine(Machine &machine, long now)
+{
+    char chunk[128];
+    for (;;)
+    {
+        ssize_t count = read(machine.fd, chunk, sizeof(chunk));
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+        if (count <= 0)
+        {
+            closeMachine(machine, now);
+            return;
+        }
+
+        for (ssize_t i = 0; i < count; i++)
+        {
+            char c = chunk[i];
+            if (c == '\r' || c == '\n')
+            {
+                if (machine.lineLength > 0)
+                {
+                    machine.line[machine.lineLength] = '\0';
+                    Sample sample;
+                    if (parseReply(machine.line, sample))
+                        onSample(machine, sample);
+                    machine.lineLength = 0;
+                }
+            }
+            else if (machine.lineLength < LINE_MAX_LENGTH - 1)
+            {
+                machine.line[machine.lineLength++] = c;
+            }
+        }
+    }
+}
+
+static void sendQuery(Machine &machine, long now)
+{
+    // Two bytes fit any non-full TX queue; a full one just skips this round
+    ssize_t count = write(machine.fd, "Q\n", 2);
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        closeMachine(machine, now);
+}
+
+// Rolling CSV: past maxBytes the file moves to <path>.1 and a new one starts
+class SeriesWriter
+{
+public:
+    SeriesWriter(const std::string &path, long maxBytes) : path(path), maxBytes(maxBytes), file(NULL) {}
+    ~SeriesWriter()
+    {
+        if (file)
+            fclose(file);
+    }
+
+    FILE *begin()
+    {
+        if (file && ftell(file) >= maxBytes)
+        {
+            fclose(file);
+            file = NULL;
+            rename(path.c_str(), (path + ".1").c_str());
+        }
+        if (!file)
+        {
+            file = fopen(path.c_str(), "a");
+            if (!file)
+                return NULL;
+            fseek(file, 0, SEEK_END);
+            if (ftell(file) == 0)
+                fprintf(file, "time,machine,online,state,phase,batch,moulds,cycles,moulds_per_hour,"
+                              "cycle_mean_ms,bottleneck,bottleneck_ms\n");
+        }
+        return file;
+    }
+
+    void end()
+    {
+        if (file)
+            fflush(file);
+    }
+
+private:
+    std::string path;
+    long maxBytes;
+    FILE *file;
+};
+
+static void writeReport(SeriesWriter &series, std::vector<Machine> &machines)
+{
+    FILE *out = series.begin();
+    if (!out)
+        return;
+
+    time_t now = time(NULL);
+    double fleetRate = 0;
+    unsigned long fleetCycles = 0;
+    int online = 0;
+
+    for (size_t m = 0; m < machines.size(); m++)
+    {
+        Machine &machine = machines[m];
+        if (!machine.haveSample)
+            continue;
+
+        const Sample &sample = machine.last;
+        int slowest = 0;
+        for (int i = 1; i < PHASE_TIMES; i++)
+        {
+            if (sample.phaseMean[i] > sample.phaseMean[slowest])
+                slowest = i;
+        }
+
+        fprintf(out, "%ld,%s,%d,%u,%s,%u,%u,%lu,%.1f,%lu,%s,%lu\n",
+                (long)now, machine.path.c_str(), machine.fresh ? 1 : 0, sample.menuState,
+                sample.phase < (unsigned)PHASE_COUNT ? PHASE_NAMES[sample.phase] : "?",
+                sample.batchCount, sample.mouldCount, sample.cycles, machine.mouldsPerHour,
+                sample.cycleMean, PHASE_NAMES[FIRST_TIMED_PHASE + slowest], sample.phaseMean[slowest]);
+
+        if (machine.fresh)
+        {
+            fleetRate += machine.mouldsPerHour;
+            fleetCycles += sample.cycles;
+            online++;
+        }
+        machine.fresh = false;
+    }
+
+    fprintf(out, "%ld,FLEET,%d,,,,,%lu,%.1f,,,\n", (long)now, online, fleetCycles, fleetRate);
+    series.end();
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-b baud] [-i interval_ms] [-o file.csv] [-s max_bytes] port...\n"
+            "  -b  serial baud rate (default 115200)\n"
+            "  -i  query and report interval (default 5000 ms)\n"
+            "  -o  time-series output (default fleet.csv)\n"
+            "  -s  roll the output to <file>.1 past this size (default 10 MB)\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    long baud = 115200;
+    long interval = 5000;
+    long maxBytes = 10L * 1024 * 1024;
+    std::string output = "fleet.csv";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:i:o:s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            baud = atol(optarg);
+            break;
+        case 'i':
+            interval = atol(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 's':
+            maxBytes = atol(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc || interval <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Machine> machines(argc - optind);
+    for (size_t m = 0; m < machines.size(); m++)
+    {
+        Machine &machine = machines[m];
+        machine.path = argv[optind + m];
+        machine.fd = -1;
+        machine.nextOpenTime = 0;
+        machine.lineLength = 0;
+        machine.haveSample = false;
+        machine.fresh = false;
+        machine.haveBaseline = false;
+        machine.mouldsPerHour = 0;
+    }
+
+    SeriesWriter series(output, maxBytes);
+    speed_t speed = baudConstant(baud);
+    std::vector<struct pollfd> fds;
+    std::vector<size_t> owners;
+    long nextQuery = monotonicMs();
+    bool reportDue = false;
+
+    while (running)
+    {
+        long now = monotonicMs();
+
+        if (now - nextQuery >= 0)
+        {
+            // Replies to the previous round have had a full interval to arrive
+            if (reportDue)
+                writeReport(series, machines);
+            for (size_t m = 0; m < machines.size(); m++)
+            {
+                if (machines[m].fd < 0 && now - machines[m].nextOpenTime >= 0)
+                    openMachine(machines[m], speed, now);
+                if (machines[m].fd >= 0)
+                    sendQuery(machines[m], now);
+            }
+            reportDue = true;
+            nextQuery += interval;
+            if (now - nextQuery >= 0)
+                nextQuery = now + interval;
+        }
+
+        fds.clear();
+        owners.clear();
+        for (size_t m = 0; m < machines.size(); m++)
+        {
+            if (machines[m].fd < 0)
+                continue;
+            struct pollfd entry = {machines[m].fd, POLLIN, 0};
+            fds.push_back(entry);
+            owners.push_back(m);
+        }
+
+        long wait = nextQuery - now;
+        int ready = poll(fds.empty() ? NULL : &fds[0], fds.size(), wait > 0 ? (int)wait : 0);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+
+        now = monotonicMs();
+        for (size_t i = 0; i < fds.size() && ready > 0; i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+            ready--;
+            Machine &machine = machines[owners[i]];
+            if (fds[i].revents & POLLIN)
+                readMachine(machine, now);
+            else if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+                closeMachine(machine, now);
+        }
+    }
+
+    for (size_t m = 0; m < machines.size(); m++)
+    {
+        if (machines[m].fd >= 0)
+            close(machines[m].fd);
+    }
+    return 0;
+}
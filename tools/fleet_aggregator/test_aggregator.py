@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Runs fleet_aggregator against pseudo-terminals that answer Q like the
+firmware, then checks the CSV it wrote.
+
+Each port is a symlink to a pty slave, so a controller can be unplugged
+(master closed) and plugged back in (a new pty behind the same path).
+
+usage: test_aggregator.py [path/to/fleet_aggregator]
+"""
+
+import csv
+import os
+import pty
+import select
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+
+INTERVAL_MS = 200
+REOPEN_S = 5.0          # REOPEN_INTERVAL_MS in the tool
+
+# Mean phase times in "pt=" order, mixer prep first; mixing is the slowest
+PHASE_MEANS = [1500, 2000, 1800, 2600, 45000, 0, 9000, 4000, 3500]
+BOTTLENECK = ("mixing", 45000)
+
+HEADER = ["time", "machine", "online", "state", "phase", "batch", "moulds", "cycles",
+          "moulds_per_hour", "cycle_mean_ms", "bottleneck", "bottleneck_ms"]
+
+failures = 0
+
+
+def check(condition, message):
+    global failures
+    if not condition:
+        failures += 1
+        print("FAIL: " + message)
+
+
+class Controller:
+    """A pty that answers each Q with a canned reply, one more cycle each time."""
+
+    def __init__(self, path, batch):
+        self.path = path
+        self.batch = batch
+        self.master = -1
+        self.slave = -1
+        self.pending = b""
+        self.plug()
+
+    def plug(self):
+        self.master, self.slave = pty.openpty()
+        tty.setraw(self.slave)
+        os.set_blocking(self.master, False)
+        self.started = time.monotonic()
+        self.cycles = 0
+        link = self.path + ".new"
+        os.symlink(os.ttyname(self.slave), link)
+        os.replace(link, self.path)
+
+    def unplug(self):
+        os.close(self.master)
+        os.close(self.slave)
+        self.master = self.slave = -1
+        self.pending = b""
+
+    def serve(self):
+        try:
+            self.pending += os.read(self.master, 256)
+        except (BlockingIOError, OSError):
+            return
+        while b"\n" in self.pending:
+            line, self.pending = self.pending.split(b"\n", 1)
+            if line.strip() == b"Q":
+                self.cycles += 1
+                uptime = int((time.monotonic() - self.started) * 1000) + 1000
+                reply = "Q t=%d st=3 ph=5 el=1200 b=%d m=%d mc=%d ma=71000 pt=%s\r\n" % (
+                    uptime, self.batch, self.cycles, self.cycles, ",".join(map(str, PHASE_MEANS)))
+                os.write(self.master, reply.encode())
+
+
+def serve(controllers, seconds):
+    deadline = time.monotonic() + seconds
+    while time.monotonic() < deadline:
+        masters = [c.master for c in controllers if c.master >= 0]
+        ready, _, _ = select.select(masters, [], [], 0.05)
+        for controller in controllers:
+            if controller.master in ready:
+                controller.serve()
+
+
+def start(tool, output, ports, extra=()):
+    command = [tool, "-i", str(INTERVAL_MS), "-o", output] + list(extra) + ports
+    return subprocess.Popen(command, stderr=subprocess.PIPE, universal_newlines=True)
+
+
+def stop(process):
+    process.send_signal(signal.SIGTERM)
+    _, errors = process.communicate(timeout=5)
+    check(process.returncode == 0, "tool exited with %d" % process.returncode)
+    return errors
+
+
+def read_rows(path):
+    with open(path) as f:
+        rows = list(csv.reader(f))
+    check(rows and rows[0] == HEADER, "%s does not start with the header" % path)
+    for row in rows[1:]:
+        check(len(row) == len(HEADER), "%s: malformed row %s" % (path, row))
+    return rows[1:]
+
+
+def test_rows_and_reconnect(tool, directory):
+    a = Controller(os.path.join(directory, "ttyA"), batch=4)
+    b = Controller(os.path.join(directory, "ttyB"), batch=7)
+    output = os.path.join(directory, "fleet.csv")
+    process = start(tool, output, [a.path, b.path])
+
+    serve([a, b], 1.5)
+    a.unplug()
+    lost_at = time.monotonic()
+    serve([b], 1.0)
+    a.plug()
+    serve([a, b], REOPEN_S - (time.monotonic() - lost_at) + 1.5)
+    errors = stop(process)
+
+    check(errors.count("fleet: opened " + a.path) == 2, "A was not reopened:\n" + errors)
+    check(errors.count("fleet: lost " + a.path) == 1, "A hangup not seen:\n" + errors)
+    check("fleet: lost " + b.path not in errors, "B dropped:\n" + errors)
+
+    rows = read_rows(output)
+    fleet = [row for row in rows if row[1] == "FLEET"]
+    check(len(fleet) >= 30, "only %d reports in %d ms intervals" % (len(fleet), INTERVAL_MS))
+
+    for controller in (a, b):
+        mine = [row for row in rows if row[1] == controller.path]
+        answered = [row for row in mine if row[2] == "1"]
+        check(len(answered) >= 10, "%s answered only %d times" % (controller.path, len(answered)))
+        for row in answered:
+            check(row[3:6] == ["3", "mixing", str(controller.batch)],
+                  "%s: state/phase/batch wrong in %s" % (controller.path, row))
+            check(row[6] == row[7], "%s: moulds and cycles differ in %s" % (controller.path, row))
+            check(row[9] == "71000", "%s: cycle mean wrong in %s" % (controller.path, row))
+            check((row[10], int(row[11])) == BOTTLENECK, "%s: bottleneck wrong in %s" % (controller.path, row))
+        # The first reply after an open is the rate baseline; with one cycle
+        # per reply every later one shows a rate
+        for previous, row in zip(mine, mine[1:]):
+            if previous[2] == "1" and row[2] == "1":
+                check(float(row[8]) > 0, "%s: no moulds/hour in %s" % (controller.path, row))
+
+    # A is offline while unplugged, then answers again with a fresh count
+    a_rows = [row for row in rows if row[1] == a.path]
+    states = "".join(row[2] for row in a_rows)
+    check("10" in states and "01" in states, "A never went offline and back: " + states)
+    back = states.index("01", states.index("10")) + 1
+    check(int(a_rows[back][7]) < int(a_rows[back - 1][7]), "A's cycles did not restart after the reconnect")
+    check(any(row[2] == "1" for row in fleet) and any(row[2] == "2" for row in fleet),
+          "FLEET online never showed one machine missing")
+    for row in fleet:
+        check(row[7] != "" and float(row[8]) >= 0, "malformed FLEET row %s" % row)
+
+    a.unplug()
+    b.unplug()
+
+
+def test_roll(tool, directory):
+    a = Controller(os.path.join(directory, "ttyR"), batch=1)
+    output = os.path.join(directory, "roll.csv")
+    max_bytes = 600
+    process = start(tool, output, [a.path], ["-s", str(max_bytes)])
+    serve([a], 2.0)
+    stop(process)
+
+    check(os.path.exists(output + ".1"), "output never rolled to .1")
+    if os.path.exists(output + ".1"):
+        rolled = read_rows(output + ".1")
+        check(rolled, "rolled file has no rows")
+        check(os.path.getsize(output + ".1") >= max_bytes, "rolled before reaching -s")
+        check(os.path.getsize(output + ".1") < max_bytes + 400, "rolled file grew well past -s")
+    read_rows(output)
+    a.unplug()
+
+
+def main():
+    tool = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "./fleet_aggregator")
+    with tempfile.TemporaryDirectory() as directory:
+        test_rows_and_reconnect(tool, directory)
+        test_roll(tool, directory)
+    print("aggregator: %s" % ("PASS" if failures == 0 else "FAIL (%d)" % failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())